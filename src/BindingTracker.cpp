@@ -0,0 +1,147 @@
+#include "BindingTracker.hpp"
+#include "VisualObject.hpp"
+#include "Profiler.hpp"
+#include "ThreadPool.hpp"
+#include <algorithm>
+
+namespace xsmall_hmi {
+
+BindingTracker::BindingTracker(VariableDatabase& db)
+    : db_(db) {
+}
+
+BindingTracker::~BindingTracker() {
+    clear();
+}
+
+void BindingTracker::track(VisualObject* object) {
+    const std::vector<VariableId>& inputs = object->resolveBinding(db_);
+    if (!object->getBinding().isCompiled()) return;
+    
+    // Destroying the object untracks it
+    object->tracker_ = this;
+    // An expression depends on every variable it reads
+    for (VariableId id : inputs) {
+        if (id >= dependents_.size()) {
+            dependents_.resize(id + 1);
+            subscriptions_.resize(id + 1);
+        }
+        
+        if (!subscriptions_[id].isActive()) {
+            // One subscription per variable, shared by all of its dependents
+            // and kept when they go away
+            subscriptions_[id] = db_.subscribe(
+                id, [this, id](const std::string&, const VariableDatabase::ValueType&) {
+                    onVariableChanged(id);
+                });
+        }
+        dependents_[id].push_back(object);
+    }
+    
+    markDirty(object);
+}
+
+void BindingTracker::untrack(VisualObject* object) {
+    if (object->tracker_ != this) return;
+    object->tracker_ = nullptr;
+    
+    for (VariableId id : object->getBinding().inputs()) {
+        if (id < dependents_.size()) {
+            auto& dependents = dependents_[id];
+            dependents.erase(std::remove(dependents.begin(), dependents.end(), object), dependents.end());
+        }
+    }
+    
+    if (object->updatePending_) {
+        dirty_.erase(std::remove(dirty_.begin(), dirty_.end(), object), dirty_.end());
+        object->setUpdatePending(false);
+    }
+}
+
+void BindingTracker::markDirty(VisualObject* object) {
+    if (!object->updatePending_) {
+        object->setUpdatePending(true);
+        dirty_.push_back(object);
+    }
+}
+
+void BindingTracker::clear() {
+    for (auto& dependents : dependents_) {
+        for (VisualObject* object : dependents) {
+            object->tracker_ = nullptr;
+        }
+        dependents.clear();
+    }
+    for (VisualObject* object : dirty_) {
+        object->tracker_ = nullptr;
+        object->setUpdatePending(false);
+    }
+    dirty_.clear();
+}
+
+std::size_t BindingTracker::updateDirty() {
+    std::size_t updated = dirty_.size();
+    if (pool_ && updated >= ParallelThreshold) {
+        updateParallel();
+    } else {
+        updateSerial();
+    }
+    Profiler::count(Profiler::Counter::ObjectsUpdated, updated);
+    dirty_.clear();
+    return updated;
+}
+
+void BindingTracker::updateSerial() {
+    if (Profiler::enabled()) {
+        for (VisualObject* object : dirty_) {
+            object->setUpdatePending(false);
+            Profiler::ObjectScope scope(object->getType(), Profiler::ObjectWork::Update);
+            object->update(db_);
+        }
+    } else {
+        for (VisualObject* object : dirty_) {
+            object->setUpdatePending(false);
+            object->update(db_);
+        }
+    }
+}
+
+void BindingTracker::updateParallel() {
+    // Nothing writes the database during the update phase, and update()
+    // only changes its own object (and that object's SceneStore slots), so
+    // chunks are independent and the result matches a serial update.
+    // Profiler totals are kept per chunk and merged in chunk order.
+    const VariableDatabase& db = db_;
+    if (Profiler::enabled()) {
+        std::vector<Profiler::ObjectTimes> chunkTimes((dirty_.size() + ChunkSize - 1) / ChunkSize,
+                                                      Profiler::ObjectTimes{});
+        pool_->parallelFor(dirty_.size(), ChunkSize, [&](std::size_t begin, std::size_t end) {
+            Profiler::ObjectTimes& times = chunkTimes[begin / ChunkSize];
+            for (std::size_t i = begin; i < end; ++i) {
+                VisualObject* object = dirty_[i];
+                object->setUpdatePending(false);
+                auto start = Profiler::Clock::now();
+                object->update(db);
+                times[static_cast<std::size_t>(object->getType())] += Profiler::Clock::now() - start;
+            }
+        });
+        for (const auto& times : chunkTimes) {
+            Profiler::instance().addObjectTimes(Profiler::ObjectWork::Update, times);
+        }
+    } else {
+        pool_->parallelFor(dirty_.size(), ChunkSize, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; ++i) {
+                dirty_[i]->setUpdatePending(false);
+                dirty_[i]->update(db);
+            }
+        });
+    }
+}
+
+void BindingTracker::onVariableChanged(VariableId id) {
+    for (VisualObject* object : dependents_[id]) {
+        markDirty(object);
+    }
+}
+
+} // namespace xsmall_hmi
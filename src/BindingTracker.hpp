@@ -0,0 +1,53 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include "VariableDatabase.hpp"
+
+namespace xsmall_hmi {
+
+class VisualObject;
+class ThreadPool;
+
+// Maps variables to the objects bound to them, through every variable a
+// binding expression reads. A variable change marks only its dependents
+// dirty, and updateDirty() updates just that set, so the cost of a frame
+// follows the number of changes instead of the number of objects.
+class BindingTracker {
+public:
+    explicit BindingTracker(VariableDatabase& db);
+    ~BindingTracker();
+    BindingTracker(const BindingTracker&) = delete;
+    BindingTracker& operator=(const BindingTracker&) = delete;
+    
+    // An object untracks itself when destroyed
+    void track(VisualObject* object);
+    void untrack(VisualObject* object);
+    void markDirty(VisualObject* object);
+    // Forgets every tracked object; subscriptions stay for reuse
+    void clear();
+    
+    // Large dirty sets are updated in chunks on the pool, reading the
+    // database as it stands after the frame's dispatch. Null updates serially.
+    void setThreadPool(ThreadPool* pool) { pool_ = pool; }
+    
+    std::size_t updateDirty();
+    std::size_t dirtyCount() const { return dirty_.size(); }
+    
+private:
+    // Below this many dirty objects the hand-off costs more than it saves
+    static constexpr std::size_t ParallelThreshold = 512;
+    static constexpr std::size_t ChunkSize = 128;
+    
+    void onVariableChanged(VariableId id);
+    void updateSerial();
+    void updateParallel();
+    
+    VariableDatabase& db_;
+    ThreadPool* pool_ = nullptr;
+    std::vector<std::vector<VisualObject*>> dependents_;
+    // Indexed by variable; inactive where nothing depends on it yet
+    std::vector<Subscription> subscriptions_;
+    std::vector<VisualObject*> dirty_;
+};
+
+} // namespace xsmall_hmi
@@ -0,0 +1,220 @@
+#include "DataSources.hpp"
+#include <SFML/Network.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+namespace xsmall_hmi {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const double Pi = 3.14159265358979323846;
+
+double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+std::string trim(const std::string& text) {
+    std::size_t first = text.find_first_not_of(" \t\r");
+    if (first == std::string::npos) return std::string();
+    std::size_t last = text.find_last_not_of(" \t\r");
+    return text.substr(first, last - first + 1);
+}
+
+} // namespace
+
+VariableDatabase::ValueType parseFeedValue(const std::string& text) {
+    // Numbers become float, the type bound objects read
+    const char* begin = text.c_str();
+    char* end = nullptr;
+    double number = std::strtod(begin, &end);
+    if (end != begin && *end == '\0') {
+        return static_cast<float>(number);
+    }
+    return text;
+}
+
+SignalGenerator::SignalGenerator(std::vector<std::string> tags, double updatesPerSecond,
+                                 double amplitude, double offset, double periodSeconds)
+    : tags_(std::move(tags)), updatesPerSecond_(updatesPerSecond),
+      amplitude_(amplitude), offset_(offset), periodSeconds_(periodSeconds) {
+}
+
+bool SignalGenerator::prepare(VariableDatabase& db) {
+    ids_.clear();
+    for (const auto& tag : tags_) {
+        ids_.push_back(db.resolveId(tag));
+    }
+    return !ids_.empty() && updatesPerSecond_ > 0.0;
+}
+
+void SignalGenerator::run(UpdateSink& sink, const std::atomic<bool>& stop) {
+    const Clock::time_point start = Clock::now();
+    const double count = static_cast<double>(ids_.size());
+    std::uint64_t sent = 0;
+    std::size_t cursor = 0;
+    
+    while (!stop.load(std::memory_order_relaxed)) {
+        const double elapsed = secondsSince(start);
+        const auto due = static_cast<std::uint64_t>(elapsed * updatesPerSecond_);
+        
+        // After a stall, catch up at most one second of updates
+        const auto limit = static_cast<std::uint64_t>(updatesPerSecond_);
+        if (due > sent + limit) sent = due - limit;
+        
+        for (; sent < due; ++sent) {
+            std::size_t tag = cursor;
+            cursor = cursor + 1 == ids_.size() ? 0 : cursor + 1;
+            double phase = elapsed / periodSeconds_ + tag / count;
+            sink.push(ids_[tag], static_cast<float>(offset_ + amplitude_ * std::sin(2.0 * Pi * phase)));
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+CsvReplaySource::CsvReplaySource(std::string path, double speed, bool loop)
+    : path_(std::move(path)), speed_(speed > 0.0 ? speed : 1.0), loop_(loop) {
+}
+
+bool CsvReplaySource::prepare(VariableDatabase& db) {
+    // Parsed up front so names are interned on the owning thread
+    std::ifstream file(path_);
+    if (!file) return false;
+    
+    records_.clear();
+    std::string line;
+    while (std::getline(file, line)) {
+        std::size_t firstComma = line.find(',');
+        std::size_t secondComma = firstComma == std::string::npos ? firstComma : line.find(',', firstComma + 1);
+        if (secondComma == std::string::npos) continue;
+        
+        std::string timeText = trim(line.substr(0, firstComma));
+        char* end = nullptr;
+        double time = std::strtod(timeText.c_str(), &end);
+        if (timeText.empty() || *end != '\0') continue;   // header or malformed
+        
+        std::string name = trim(line.substr(firstComma + 1, secondComma - firstComma - 1));
+        if (name.empty()) continue;
+        
+        records_.push_back({time, db.resolveId(name), parseFeedValue(trim(line.substr(secondComma + 1)))});
+    }
+    return !records_.empty();
+}
+
+void CsvReplaySource::run(UpdateSink& sink, const std::atomic<bool>& stop) {
+    do {
+        const Clock::time_point start = Clock::now();
+        const double firstTime = records_.front().time;
+        std::size_t next = 0;
+        
+        while (next < records_.size() && !stop.load(std::memory_order_relaxed)) {
+            const double now = secondsSince(start) * speed_ + firstTime;
+            for (; next < records_.size() && records_[next].time <= now; ++next) {
+                sink.push(records_[next].id, records_[next].value);
+            }
+            if (next < records_.size()) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+    } while (loop_ && !stop.load(std::memory_order_relaxed));
+}
+
+TrafficReplaySource::TrafficReplaySource(std::string path, double speed, bool loop)
+    : path_(std::move(path)), speed_(std::max(speed, 0.0)), loop_(loop) {
+}
+
+bool TrafficReplaySource::prepare(VariableDatabase& db) {
+    if (!log_.open(path_) || log_.events().empty()) return false;
+    
+    ids_.clear();
+    for (const std::string& name : log_.names()) {
+        ids_.push_back(db.resolveId(name));
+    }
+    return true;
+}
+
+void TrafficReplaySource::run(UpdateSink& sink, const std::atomic<bool>& stop) {
+    const auto& events = log_.events();
+    do {
+        const Clock::time_point start = Clock::now();
+        std::size_t next = 0;
+        
+        while (next < events.size() && !stop.load(std::memory_order_relaxed)) {
+            if (speed_ == 0.0) {
+                const TrafficLog::Event& event = events[next];
+                if (sink.queue().tryPush(DataUpdate{ids_[event.variable], event.value, VariableDatabase::now()})) {
+                    ++next;
+                } else {
+                    std::this_thread::yield();
+                }
+                continue;
+            }
+            
+            const double now = secondsSince(start) * speed_ * 1e6;
+            for (; next < events.size() && events[next].time <= now; ++next) {
+                sink.push(ids_[events[next].variable], events[next].value);
+            }
+            if (next < events.size()) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+    } while (loop_ && !stop.load(std::memory_order_relaxed));
+}
+
+UdpListenerSource::UdpListenerSource(unsigned short port, std::vector<std::string> tags)
+    : port_(port), tags_(std::move(tags)) {
+}
+
+bool UdpListenerSource::prepare(VariableDatabase& db) {
+    ids_.clear();
+    for (const auto& tag : tags_) {
+        ids_.emplace(tag, db.resolveId(tag));
+    }
+    return !ids_.empty();
+}
+
+void UdpListenerSource::run(UpdateSink& sink, const std::atomic<bool>& stop) {
+    sf::UdpSocket socket;
+    if (socket.bind(port_, sf::IpAddress::LocalHost) != sf::Socket::Status::Done) {
+        std::cerr << "Failed to bind UDP port " << port_ << std::endl;
+        return;
+    }
+    
+    sf::SocketSelector selector;
+    selector.add(socket);
+    std::vector<char> buffer(sf::UdpSocket::MaxDatagramSize);
+    std::string line;
+    
+    while (!stop.load(std::memory_order_relaxed)) {
+        // Short waits keep shutdown responsive
+        if (!selector.wait(sf::milliseconds(50))) continue;
+        
+        std::size_t received = 0;
+        std::optional<sf::IpAddress> sender;
+        unsigned short senderPort = 0;
+        if (socket.receive(buffer.data(), buffer.size(), received, sender, senderPort) !=
+            sf::Socket::Status::Done) {
+            continue;
+        }
+        
+        std::istringstream lines(std::string(buffer.data(), received));
+        while (std::getline(lines, line)) {
+            std::size_t equals = line.find('=');
+            auto it = equals == std::string::npos ? ids_.end() : ids_.find(trim(line.substr(0, equals)));
+            if (it == ids_.end()) {
+                if (!trim(line).empty()) rejected_.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+            sink.push(it->second, parseFeedValue(trim(line.substr(equals + 1))));
+        }
+    }
+}
+
+} // namespace xsmall_hmi
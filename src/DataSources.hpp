@@ -0,0 +1,103 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Ingestion.hpp"
+#include "TrafficLog.hpp"
+
+namespace xsmall_hmi {
+
+// Simulated signals: each tag follows a sine wave with its own phase.
+// Updates are spread evenly over the configured rate (updates per second
+// across all tags).
+class SignalGenerator : public DataSource {
+public:
+    SignalGenerator(std::vector<std::string> tags, double updatesPerSecond,
+                    double amplitude = 50.0, double offset = 50.0, double periodSeconds = 10.0);
+    
+    std::string name() const override { return "signal generator"; }
+    bool prepare(VariableDatabase& db) override;
+    void run(UpdateSink& sink, const std::atomic<bool>& stop) override;
+    
+private:
+    std::vector<std::string> tags_;
+    std::vector<VariableId> ids_;
+    double updatesPerSecond_;
+    double amplitude_;
+    double offset_;
+    double periodSeconds_;
+};
+
+// Replays a CSV recording of "time,name,value" lines (time in seconds,
+// a header line is allowed). Numeric values are replayed as floats,
+// anything else as strings. Timing follows the recording scaled by speed.
+class CsvReplaySource : public DataSource {
+public:
+    explicit CsvReplaySource(std::string path, double speed = 1.0, bool loop = false);
+    
+    std::string name() const override { return "replay " + path_; }
+    bool prepare(VariableDatabase& db) override;
+    void run(UpdateSink& sink, const std::atomic<bool>& stop) override;
+    
+    std::size_t recordCount() const { return records_.size(); }
+    
+private:
+    struct Record {
+        double time;
+        VariableId id;
+        VariableDatabase::ValueType value;
+    };
+    
+    std::string path_;
+    double speed_;
+    bool loop_;
+    std::vector<Record> records_;
+};
+
+// Replays a TrafficRecorder log in real time at `speed` times the recorded
+// rate. Speed 0 replays as fast as the UI drains the queue, waiting for room
+// instead of dropping, so every recorded write arrives.
+class TrafficReplaySource : public DataSource {
+public:
+    explicit TrafficReplaySource(std::string path, double speed = 1.0, bool loop = false);
+    
+    std::string name() const override { return "replay " + path_; }
+    bool prepare(VariableDatabase& db) override;
+    void run(UpdateSink& sink, const std::atomic<bool>& stop) override;
+    
+    std::size_t eventCount() const { return log_.events().size(); }
+    
+private:
+    std::string path_;
+    double speed_;
+    bool loop_;
+    TrafficLog log_;
+    std::vector<VariableId> ids_;
+};
+
+// Stand-in for a PLC gateway: listens on a local UDP port for datagrams of
+// "name=value" lines. Only the configured tags are accepted; the rest are
+// counted and ignored.
+class UdpListenerSource : public DataSource {
+public:
+    UdpListenerSource(unsigned short port, std::vector<std::string> tags);
+    
+    std::string name() const override { return "udp:" + std::to_string(port_); }
+    bool prepare(VariableDatabase& db) override;
+    void run(UpdateSink& sink, const std::atomic<bool>& stop) override;
+    
+    std::uint64_t rejectedLines() const { return rejected_.load(std::memory_order_relaxed); }
+    
+private:
+    unsigned short port_;
+    std::vector<std::string> tags_;
+    std::unordered_map<std::string, VariableId> ids_;
+    std::atomic<std::uint64_t> rejected_{0};
+};
+
+// Parses feed payload values: a float if the whole text is a number,
+// otherwise the text itself
+VariableDatabase::ValueType parseFeedValue(const std::string& text);
+
+} // namespace xsmall_hmi
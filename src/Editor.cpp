@@ -1,85 +1,264 @@
 #include "Editor.hpp"
+#include "DataSources.hpp"
+#include "ResourceCache.hpp"
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 
 namespace xsmall_hmi {
 
+namespace {
+
+// Pending work is picked up at this rate while no input arrives
+const sf::Time TickInterval = sf::milliseconds(16);
+// Running data sources cannot wake the event wait, so with nothing queued
+// the loop still looks for their next update at this rate
+const sf::Time SourcePollInterval = sf::milliseconds(100);
+
+} // namespace
+
 Editor::Editor() 
     : window_(sf::VideoMode(sf::Vector2u(1200, 800)), "XSmall-HMI Editor", sf::Style::Close) {
     
-    window_.setFramerateLimit(60);
+    if (!canvas_.resize(window_.getSize())) {
+        std::cerr << "Failed to create the scene canvas" << std::endl;
+    }
+    variableDatabase_.setNotificationMode(VariableDatabase::NotificationMode::Deferred);
+    bindings_.setThreadPool(&updatePool_);
     
     variableDatabase_.setVariable("sensor_value", 50.0f); 
-    auto sensorText = std::make_unique<TextObject>("sensor_text");
+    if (historian_.open("sensor_history.xhh")) {
+        // Sensor noise below half a unit is not worth storing
+        SubscribeOptions historyFilter;
+        historyFilter.deadband = SubscribeOptions::Deadband::Absolute;
+        historyFilter.deadbandValue = 0.5;
+        historian_.record("sensor_value", historyFilter);
+    }
+    
+    auto* sensorText = objects_.create<TextObject>("sensor_text");
     sensorText->setPosition(sf::Vector2f(250, 50));
     sensorText->setSize(sf::Vector2f(200, 30));
     sensorText->setText("Sensor Value: ");
-    sensorText->setVariableBinding("sensor_value");
-    objects_.push_back(std::move(sensorText));
+    FormatSpec sensorFormat;
+    sensorFormat.precision = 1;
+    sensorFormat.prefix = "Sensor Value: ";
+    sensorText->setFormat(sensorFormat);
+    sensorText->setVariableBinding(variableDatabase_, "sensor_value");
+    addObject(sensorText);
     
-    auto sensorButton = std::make_unique<ButtonObject>("sensor_button");
+    auto* sensorButton = objects_.create<ButtonObject>("sensor_button");
     sensorButton->setPosition(sf::Vector2f(250, 100));
     sensorButton->setSize(sf::Vector2f(150, 40));
     sensorButton->setText("Random Sensor");
-    sensorButton->setCallback([this]() {
-        float randomValue = 20.0f + rand() % 60;
-        variableDatabase_.setVariable("sensor_value", randomValue);
-    });
-    objects_.push_back(std::move(sensorButton));
+    addObject(sensorButton);
+    setRandomSensorCallback(sensorButton);
     
-    auto graph = std::make_unique<HistoryGraphObject>("sensor_graph");
+    auto* graph = objects_.create<HistoryGraphObject>("sensor_graph");
     graph->setPosition(sf::Vector2f(250, 200));
     graph->setSize(sf::Vector2f(400, 200));
-    graph->setVariableBinding("sensor_value");
+    graph->setVariableBinding(variableDatabase_, "sensor_value");
+    graph->setHistoryDepth(3600);
+    graph->backfill(historian_, Historian::now() - 3600.0, Historian::now());
     graph->addValue(50.0f); 
-    objects_.push_back(std::move(graph));
+    addObject(graph);
+    
+    auto* flowGraph = objects_.create<HistoryGraphObject>("flow_graph");
+    flowGraph->setPosition(sf::Vector2f(250, 450));
+    flowGraph->setSize(sf::Vector2f(400, 200));
+    flowGraph->setVariableBinding(variableDatabase_, "sim_flow");
+    addObject(flowGraph);
+    
+    auto* flowStatus = objects_.create<TextObject>("flow_status");
+    flowStatus->setPosition(sf::Vector2f(670, 450));
+    flowStatus->setSize(sf::Vector2f(200, 30));
+    flowStatus->setVariableBinding(variableDatabase_, "=sim_flow > 80 ? \"Flow HIGH\" : \"Flow normal\"");
+    addObject(flowStatus);
+    
+    // Simulated plant signals plus a local UDP port ("name=value" lines)
+    // standing in for a PLC gateway
+    ingestion_.addSource(std::make_unique<SignalGenerator>(
+        std::vector<std::string>{"sim_flow", "sim_pressure", "sim_level"}, 300.0));
+    ingestion_.addSource(std::make_unique<UdpListenerSource>(
+        5020, std::vector<std::string>{"sensor_value", "sim_flow", "sim_pressure", "sim_level"}));
+    ingestion_.start(variableDatabase_);
 }
 
 void Editor::run() {
+    Profiler& profiler = Profiler::instance();
     while (window_.isOpen()) {
+        profiler.beginFrame();
         handleEvents();
         update();
         render();
+        profiler.endFrame();
     }
 }
 
 void Editor::handleEvents() {
-    while (auto event = window_.pollEvent()) {
+    // Sleeps until input arrives; while work is queued, at most until the
+    // next tick is due
+    std::optional<sf::Event> event;
+    if (hasPendingWork()) {
+        const sf::Time untilTick = TickInterval - tickClock_.getElapsedTime();
+        event = untilTick > sf::Time::Zero ? window_.waitEvent(untilTick) : window_.pollEvent();
+    } else if (ingestion_.isRunning()) {
+        event = window_.waitEvent(SourcePollInterval);
+    } else {
+        event = window_.waitEvent();
+    }
+    
+    Profiler::Scope scope(Profiler::Phase::Events);
+    for (; event; event = window_.pollEvent()) {
+        // Bare pointer motion changes nothing on screen
+        if (!event->is<sf::Event::MouseMoved>() || bandActive_) {
+            chromeDirty_ = true;
+        }
+        
         if (event->is<sf::Event::Closed>()) {
             window_.close();
         } else if (auto* mousePress = event->getIf<sf::Event::MouseButtonPressed>()) {
             if (mousePress->button == sf::Mouse::Button::Left) {
                 handleMouseClick(sf::Vector2i(mousePress->position.x, mousePress->position.y));
             }
+        } else if (auto* mouseRelease = event->getIf<sf::Event::MouseButtonReleased>()) {
+            if (mouseRelease->button == sf::Mouse::Button::Left) {
+                handleMouseReleased(mouseRelease->position);
+            }
+        } else if (auto* mouseMove = event->getIf<sf::Event::MouseMoved>()) {
+            handleMouseMoved(mouseMove->position);
         } else if (auto* textEvent = event->getIf<sf::Event::TextEntered>()) {
             handleTextEntered(textEvent->unicode);
+        } else if (auto* keyPress = event->getIf<sf::Event::KeyPressed>()) {
+            handleKeyPressed(*keyPress);
         }
     }
 }
 
+bool Editor::hasPendingWork() const {
+    return ingestion_.hasQueuedUpdates() || variableDatabase_.hasPublished() ||
+           variableDatabase_.hasPendingNotifications() ||
+           ResourceCache::instance().pendingImageCount() > 0 || Profiler::enabled();
+}
+
 void Editor::update() {
-    for (auto& obj : objects_) {
-        obj->update(variableDatabase_);
+    tickClock_.restart();
+    
+    // Values queued by data sources and producer threads become visible
+    // once per frame, then subscribers see each changed variable once with
+    // its latest value
+    {
+        Profiler::Scope scope(Profiler::Phase::Dispatch);
+        ingestion_.drain(variableDatabase_);
+        variableDatabase_.applyPublished();
+        variableDatabase_.dispatchNotifications();
+    }
+    
+    // Only objects whose bound variables changed since the last frame
+    Profiler::Scope scope(Profiler::Phase::Update);
+    bindings_.updateDirty();
+    
+    // Images decoded in the background replace their placeholders
+    if (ResourceCache::instance().processLoadedImages() > 0) {
+        for (VisualObject* obj : objects_) {
+            if (auto* image = objectCast<ImageObject>(obj)) {
+                image->refreshImage();
+            }
+        }
     }
 }
 
 void Editor::render() {
+    Profiler::Scope scope(Profiler::Phase::Render);
+    sceneRenderer_.update(objects_);
+    
+    // Nothing changed: the last presented frame is still correct
+    const bool sceneDamaged = sceneRenderer_.hasDamage();
+    if (!sceneDamaged && !chromeDirty_ && !Profiler::enabled()) return;
+    
+    if (sceneDamaged) {
+        redrawCanvas();
+    }
+    
     window_.clear(sf::Color(255, 255, 255));
+    window_.draw(sf::Sprite(canvas_.getTexture()));
+    
+    for (ObjectHandle handle : selectedObjects_) {
+        const VisualObject* obj = objects_.get(handle);
+        if (!obj) continue;
+        sf::RectangleShape highlight;
+        highlight.setPosition(obj->getBounds().position);
+        highlight.setSize(obj->getBounds().size);
+        highlight.setFillColor(sf::Color::Transparent);
+        highlight.setOutlineColor(sf::Color(0, 120, 215));
+        highlight.setOutlineThickness(1.0f);
+        window_.draw(highlight);
+    }
+    
+    if (bandActive_) {
+        sf::RectangleShape band;
+        band.setPosition(bandStart_);
+        band.setSize(bandEnd_ - bandStart_);
+        band.setFillColor(sf::Color(0, 120, 215, 40));
+        band.setOutlineColor(sf::Color(0, 120, 215));
+        band.setOutlineThickness(1.0f);
+        window_.draw(band);
+    }
+    
+    palette_.draw(window_);
+    
+    if (Profiler::enabled()) {
+        Profiler::instance().drawOverlay(window_);
+    }
+    chromeDirty_ = false;
+    
+    Profiler::Scope presentScope(Profiler::Phase::Present);
+    window_.display();
+}
+
+void Editor::redrawCanvas() {
+    const sf::Vector2f canvasSize(canvas_.getSize());
+    const sf::FloatRect canvasRect({0, 0}, canvasSize);
+    std::vector<sf::FloatRect> regions = sceneRenderer_.getDamage();
+    if (sceneRenderer_.isFullyDamaged()) {
+        regions.assign(1, canvasRect);
+    }
+    
+    // Each damaged area, widened to whole pixels, is repainted under a
+    // scissor; pixels outside keep what the previous redraw left
+    for (const sf::FloatRect& damage : regions) {
+        const sf::Vector2f topLeft(std::floor(damage.position.x), std::floor(damage.position.y));
+        const sf::Vector2f bottomRight(std::ceil(damage.position.x + damage.size.x),
+                                       std::ceil(damage.position.y + damage.size.y));
+        auto region = sf::FloatRect(topLeft, bottomRight - topLeft).findIntersection(canvasRect);
+        if (!region) continue;
+        
+        sf::View view = canvas_.getDefaultView();
+        view.setScissor(sf::FloatRect(
+            sf::Vector2f(region->position.x / canvasSize.x, region->position.y / canvasSize.y),
+            sf::Vector2f(region->size.x / canvasSize.x, region->size.y / canvasSize.y)));
+        canvas_.setView(view);
+        drawBackground(canvas_);
+        sceneRenderer_.draw(canvas_, *region);
+    }
+    
+    canvas_.setView(canvas_.getDefaultView());
+    canvas_.display();
+    sceneRenderer_.clearDamage();
+}
 
+void Editor::drawBackground(sf::RenderTarget& target) const {
+    sf::RectangleShape page;
+    page.setSize(sf::Vector2f(target.getSize()));
+    page.setFillColor(sf::Color(255, 255, 255));
+    target.draw(page);
+    
     sf::RectangleShape workspace;
     workspace.setPosition(sf::Vector2f(200, 0));
     workspace.setSize(sf::Vector2f(1000, 800));
     workspace.setFillColor(sf::Color(250, 250, 250));
     workspace.setOutlineColor(sf::Color(200, 200, 200));
     workspace.setOutlineThickness(2.0f);
-    window_.draw(workspace);
-    
-    for (const auto& obj : objects_) {
-        obj->draw(window_);
-    }
-    
-    palette_.draw(window_);
-    
-    window_.display();
+    target.draw(workspace);
 }
 
 void Editor::handleMouseClick(const sf::Vector2i& mousePos) {
@@ -91,128 +270,120 @@ void Editor::handleMouseClick(const sf::Vector2i& mousePos) {
         return;
     }
     
-    for (auto& obj : objects_) {
-        if (auto* input = dynamic_cast<InputFieldObject*>(obj.get())) {
-            input->setActive(false);
-        }
-    }
+    setFocusedInput(nullptr);
     
-    for (auto& obj : objects_) {
-        if (auto* button = dynamic_cast<ButtonObject*>(obj.get())) {
-            if (button->contains(mousePosF)) {
-                button->onClick();
-                return;
-            }
-        }
-    }
+    hits_.clear();
+    spatialIndex_.queryPoint(mousePosF, hits_);
     
-    bool clickedOnInputField = false;
-    for (auto& obj : objects_) {
-        if (auto* input = dynamic_cast<InputFieldObject*>(obj.get())) {
-            if (input->contains(mousePosF)) {
-                input->setActive(true); 
-                clickedOnInputField = true;
-                break;
-            }
+    for (auto* obj : hits_) {
+        if (auto* button = objectCast<ButtonObject>(obj)) {
+            button->onClick();
+            return;
         }
     }
     
-    if (clickedOnInputField) {
-        return;
+    for (auto* obj : hits_) {
+        if (auto* input = objectCast<InputFieldObject>(obj)) {
+            setFocusedInput(input);
+            return;
+        }
     }
     
     auto tool = palette_.getCurrentTool();
     
     switch (tool) {
         case Palette::Tool::Select:
-            selectedObject_ = nullptr;
-            for (auto it = objects_.rbegin(); it != objects_.rend(); ++it) {
-                if ((*it)->contains(mousePosF)) {
-                    selectedObject_ = it->get();
-                    break;
-                }
+            selectedObjects_.clear();
+            selectedObject_ = hits_.empty() ? ObjectHandle() : objects_.handleOf(hits_.front());
+            if (selectedObject_.isValid()) {
+                selectedObjects_.push_back(selectedObject_);
+            } else {
+                bandActive_ = true;
+                bandStart_ = mousePosF;
+                bandEnd_ = mousePosF;
             }
             break;
-            
+        
         case Palette::Tool::Rectangle: {
-            auto rect = std::make_unique<RectangleObject>("rect_" + std::to_string(objects_.size()));
+            auto* rect = objects_.create<RectangleObject>("rect_" + std::to_string(objects_.size()));
             rect->setPosition(mousePosF);
             rect->setSize(sf::Vector2f(100, 60));
             rect->setColor(sf::Color(rand() % 256, rand() % 256, rand() % 256));
-            objects_.push_back(std::move(rect));
+            addObject(rect);
             break;
         }
-            
+        
         case Palette::Tool::Line: {
-            auto line = std::make_unique<LineObject>("line_" + std::to_string(objects_.size()));
+            auto* line = objects_.create<LineObject>("line_" + std::to_string(objects_.size()));
             line->setPoints(mousePosF, mousePosF + sf::Vector2f(100, 100));
-            objects_.push_back(std::move(line));
+            addObject(line);
             break;
         }
-            
+        
         case Palette::Tool::Polyline: {
-            auto polyline = std::make_unique<PolylineObject>("poly_" + std::to_string(objects_.size()));
+            auto* polyline = objects_.create<PolylineObject>("poly_" + std::to_string(objects_.size()));
             polyline->setPosition(mousePosF);
             polyline->addPoint(mousePosF + sf::Vector2f(0, 0), true);
             polyline->addPoint(mousePosF + sf::Vector2f(100, 100), true); 
             polyline->addPoint(mousePosF + sf::Vector2f(200, 0), true);   
             polyline->addPoint(mousePosF + sf::Vector2f(300, 100), true); 
             
-            objects_.push_back(std::move(polyline));
+            addObject(polyline);
             break;
         }
-            
+        
         case Palette::Tool::Text: {
-            auto text = std::make_unique<TextObject>("text_" + std::to_string(objects_.size()));
+            auto* text = objects_.create<TextObject>("text_" + std::to_string(objects_.size()));
             text->setPosition(mousePosF);
             text->setSize(sf::Vector2f(200, 30));
-            text->setText("Sensor: ");
-            text->setVariableBinding("sensor_value");
+            // The label goes in the prefix; bound values replace the text
+            FormatSpec format;
+            format.precision = 1;
+            format.prefix = "Sensor: ";
+            text->setFormat(format);
+            text->setText(format.prefix);
+            text->setVariableBinding(variableDatabase_, "sensor_value");
             
-            objects_.push_back(std::move(text));
+            addObject(text);
             break;
         }
-            
+        
         case Palette::Tool::Button: {
-            auto button = std::make_unique<ButtonObject>("btn_" + std::to_string(objects_.size()));
+            auto* button = objects_.create<ButtonObject>("btn_" + std::to_string(objects_.size()));
             button->setPosition(mousePosF);
             button->setSize(sf::Vector2f(120, 40));
             button->setText("Random Sensor");
-            button->setCallback([this]() {
-                float randomValue = 20.0f + rand() % 60;
-                variableDatabase_.setVariable("sensor_value", randomValue);
-                std::cout << "Sensor value: " << randomValue << std::endl;
-            });
-            
-            objects_.push_back(std::move(button));
+            addObject(button);
+            setRandomSensorCallback(button);
             break;
         }
-            
+        
         case Palette::Tool::InputField: {
-            auto input = std::make_unique<InputFieldObject>("input_" + std::to_string(objects_.size()));
+            auto* input = objects_.create<InputFieldObject>("input_" + std::to_string(objects_.size()));
             input->setPosition(mousePosF);
             input->setSize(sf::Vector2f(200, 30));
-            input->setActive(true); // New input field is active by default
-            objects_.push_back(std::move(input));
+            // New input field is active by default
+            addObject(input);
+            setFocusedInput(input);
             break;
         }
-            
+        
         case Palette::Tool::HistoryGraph: {
-            auto graph = std::make_unique<HistoryGraphObject>("graph_" + std::to_string(objects_.size()));
+            auto* graph = objects_.create<HistoryGraphObject>("graph_" + std::to_string(objects_.size()));
             graph->setPosition(mousePosF);
             graph->setSize(sf::Vector2f(300, 150));
-            graph->setVariableBinding("sensor_value");
+            graph->setVariableBinding(variableDatabase_, "sensor_value");
             graph->addValue(50.0f);
-            objects_.push_back(std::move(graph));
+            addObject(graph);
             break;
         }
-            
+        
         case Palette::Tool::Image: {
-            auto image = std::make_unique<ImageObject>("img_" + std::to_string(objects_.size()));
+            auto* image = objects_.create<ImageObject>("img_" + std::to_string(objects_.size()));
             image->setPosition(mousePosF);
             image->setSize(sf::Vector2f(200, 150));
             image->loadFromFile("test_image.png");
-            objects_.push_back(std::move(image));
+            addObject(image);
             break;
         }
     }
@@ -226,14 +397,139 @@ void Editor::handleMouseClick(const sf::Vector2i& mousePos) {
     }
 }
 
-void Editor::handleTextEntered(uint32_t unicode) {
-    for (auto& obj : objects_) {
-        if (auto* input = dynamic_cast<InputFieldObject*>(obj.get())) {
-            if (input->isActive()) {
-                input->handleTextEntered(unicode);
-            }
+void Editor::handleMouseMoved(const sf::Vector2i& mousePos) {
+    if (bandActive_) {
+        bandEnd_ = sf::Vector2f(static_cast<float>(mousePos.x), static_cast<float>(mousePos.y));
+    }
+}
+
+void Editor::handleMouseReleased(const sf::Vector2i& mousePos) {
+    if (!bandActive_) return;
+    
+    bandActive_ = false;
+    bandEnd_ = sf::Vector2f(static_cast<float>(mousePos.x), static_cast<float>(mousePos.y));
+    
+    sf::Vector2f topLeft(std::min(bandStart_.x, bandEnd_.x), std::min(bandStart_.y, bandEnd_.y));
+    sf::Vector2f bottomRight(std::max(bandStart_.x, bandEnd_.x), std::max(bandStart_.y, bandEnd_.y));
+    
+    hits_.clear();
+    spatialIndex_.queryRect(sf::FloatRect(topLeft, bottomRight - topLeft), hits_);
+    selectedObjects_.clear();
+    for (VisualObject* obj : hits_) {
+        selectedObjects_.push_back(objects_.handleOf(obj));
+    }
+    selectedObject_ = selectedObjects_.empty() ? ObjectHandle() : selectedObjects_.front();
+}
+
+void Editor::addObject(VisualObject* object) {
+    bindings_.track(object);
+    spatialIndex_.insert(object);
+}
+
+void Editor::deleteSelection() {
+    // Handles to destroyed objects read as null, so a click-selected object
+    // that is also in selectedObjects_ is destroyed once
+    objects_.destroy(selectedObject_);
+    for (ObjectHandle handle : selectedObjects_) {
+        objects_.destroy(handle);
+    }
+    selectedObject_ = ObjectHandle();
+    selectedObjects_.clear();
+    hits_.clear();
+}
+
+void Editor::setFocusedInput(InputFieldObject* input) {
+    InputFieldObject* focused = objects_.get<InputFieldObject>(focusedInput_);
+    if (focused == input) return;
+    
+    if (focused) {
+        focused->setActive(false);
+    }
+    focusedInput_ = objects_.handleOf(input);
+    if (input) {
+        input->setActive(true);
+    }
+}
+
+void Editor::handleKeyPressed(const sf::Event::KeyPressed& key) {
+    const std::string sceneFilename = "scene.xhs";
+    if (key.control && key.code == sf::Keyboard::Key::S) {
+        if (saveScene(sceneFilename)) {
+            std::cout << "Scene saved to " << sceneFilename << std::endl;
+        } else {
+            std::cerr << "Failed to save " << sceneFilename << std::endl;
+        }
+    } else if (key.control && key.code == sf::Keyboard::Key::O) {
+        if (loadScene(sceneFilename)) {
+            std::cout << "Loaded " << objects_.size() << " objects from " << sceneFilename << std::endl;
+        } else {
+            std::cerr << "Failed to load " << sceneFilename << std::endl;
+        }
+    } else if (key.code == sf::Keyboard::Key::Delete && !focusedInput_.isValid()) {
+        deleteSelection();
+    } else if (key.code == sf::Keyboard::Key::F3) {
+        Profiler::instance().toggle();
+    } else if (key.code == sf::Keyboard::Key::F4 && Profiler::enabled()) {
+        const std::string filename = "profile_trace.json";
+        if (Profiler::instance().writeChromeTrace(filename)) {
+            std::cout << "Profile trace written to " << filename << std::endl;
+        } else {
+            std::cerr << "Failed to write " << filename << std::endl;
+        }
+    } else if (key.code == sf::Keyboard::Key::F5) {
+        const std::string filename = "traffic.xhr";
+        if (recorder_.isRecording()) {
+            recorder_.stop();
+            std::cout << "Recorded " << recorder_.eventCount() << " writes to " << filename << std::endl;
+        } else if (recorder_.start(filename)) {
+            std::cout << "Recording variable traffic to " << filename << std::endl;
+        } else {
+            std::cerr << "Failed to create " << filename << std::endl;
+        }
+    }
+}
+
+bool Editor::saveScene(const std::string& path) const {
+    return SceneFile::save(path, objects_);
+}
+
+bool Editor::loadScene(const std::string& path) {
+    SceneFile scene;
+    if (!scene.open(path)) return false;
+    
+    setFocusedInput(nullptr);
+    selectedObject_ = ObjectHandle();
+    selectedObjects_.clear();
+    hits_.clear();
+    bandActive_ = false;
+    bindings_.clear();
+    // Clearing the index first spares each destructor its own removal
+    spatialIndex_.clear();
+    objects_.clear();
+    
+    for (std::size_t i = 0; i < scene.objectCount(); ++i) {
+        VisualObject* added = scene.createObject(scene.object(i), variableDatabase_, objects_);
+        addObject(added);
+        // Callbacks are code, not data; buttons get the editor's default action
+        if (auto* button = objectCast<ButtonObject>(added)) {
+            setRandomSensorCallback(button);
         }
     }
+    return true;
+}
+
+void Editor::setRandomSensorCallback(ButtonObject* button) {
+    button->setCallback([this]() {
+        float randomValue = 20.0f + rand() % 60;
+        variableDatabase_.setVariable("sensor_value", randomValue);
+        std::cout << "Sensor value: " << randomValue << std::endl;
+    });
+}
+
+void Editor::handleTextEntered(uint32_t unicode) {
+    if (auto* input = objects_.get<InputFieldObject>(focusedInput_)) {
+        input->handleTextEntered(unicode);
+    }
 }
 
-} // namespace xsmall_hmi
\ No newline at end of file
+} // namespace xsmall_hmi
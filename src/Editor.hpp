@@ -4,7 +4,17 @@
 #include <vector>
 #include "VisualObject.hpp"
 #include "VariableDatabase.hpp"
+#include "BindingTracker.hpp"
+#include "Historian.hpp"
+#include "Ingestion.hpp"
 #include "Palette.hpp"
+#include "Profiler.hpp"
+#include "SceneFile.hpp"
+#include "SceneRenderer.hpp"
+#include "SceneStore.hpp"
+#include "SpatialIndex.hpp"
+#include "ThreadPool.hpp"
+#include "TrafficLog.hpp"
 
 namespace xsmall_hmi {
 
@@ -17,20 +27,60 @@ public:
     
 private:
     void handleEvents();
+    // Work queued outside the event queue that will change the scene:
+    // undrained source updates, published values, held or deferred
+    // notifications, image decodes
+    bool hasPendingWork() const;
     void update();
     void render();
+    // Repaints the damaged parts of the canvas from the scene
+    void redrawCanvas();
+    void drawBackground(sf::RenderTarget& target) const;
     
     void handleMouseClick(const sf::Vector2i& mousePos);
+    void handleMouseMoved(const sf::Vector2i& mousePos);
+    void handleMouseReleased(const sf::Vector2i& mousePos);
     void handleTextEntered(uint32_t unicode);
+    void handleKeyPressed(const sf::Event::KeyPressed& key);
+    
+    bool saveScene(const std::string& path) const;
+    bool loadScene(const std::string& path);
+    
+    // Registers an object created in objects_ once its binding is set
+    void addObject(VisualObject* object);
+    // Destroys the selected objects; each leaves the tracker and the index
+    void deleteSelection();
+    void setFocusedInput(InputFieldObject* input);
+    void setRandomSensorCallback(ButtonObject* button);
     
     sf::RenderWindow window_;
+    // Background and scene as of the last redraw; frames without scene
+    // damage present it unchanged
+    sf::RenderTexture canvas_;
+    // Selection, band or palette changed since the last present
+    bool chromeDirty_ = true;
+    sf::Clock tickClock_;
     VariableDatabase variableDatabase_;
+    BindingTracker bindings_{variableDatabase_};
+    Historian historian_{variableDatabase_};
+    Ingestion ingestion_;
+    TrafficRecorder recorder_{variableDatabase_};
+    // Shares large update phases across all cores but the UI thread's
+    ThreadPool updatePool_;
     Palette palette_;
+    SceneRenderer sceneRenderer_;
+    SpatialIndex spatialIndex_;
     
-    std::vector<std::unique_ptr<VisualObject>> objects_;
-    VisualObject* selectedObject_ = nullptr;
+    SceneStore objects_;
+    ObjectHandle selectedObject_;
+    std::vector<ObjectHandle> selectedObjects_;
+    std::vector<VisualObject*> hits_;
+    ObjectHandle focusedInput_;
     
-    sf::Font font_;
+    // Rubber-band selection in workspace coordinates
+    bool bandActive_ = false;
+    sf::Vector2f bandStart_;
+    sf::Vector2f bandEnd_;
 };
 
 } 
\ No newline at end of file
@@ -0,0 +1,437 @@
+#include "Expression.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <type_traits>
+#include <variant>
+
+namespace xsmall_hmi {
+
+// Recursive descent over the source, emitting bytecode as it goes
+class ExpressionParser {
+public:
+    using Resolver = std::function<VariableId(const std::string&)>;
+    using Op = Expression::Op;
+    
+    ExpressionParser(const std::string& source, Expression& out, const Resolver& resolve)
+        : source_(source), out_(out), resolve_(resolve) {
+    }
+    
+    // Shared by both compile flavours
+    static bool compile(Expression& out, const std::string& source, const Resolver& resolve) {
+        out.clear();
+        if (source.empty()) return false;
+        if (source[0] != Expression::Marker) {
+            // Unknown to compileExisting(): not ready yet
+            const VariableId id = resolve(source);
+            if (id == InvalidVariableId) return false;
+            out.code_.push_back({Op::Load, id});
+            out.inputs_.push_back(id);
+            out.variable_ = id;
+            return true;
+        }
+        
+        const std::string expression = source.substr(1);
+        ExpressionParser parser(expression, out, resolve);
+        if (!parser.parse()) {
+            std::string error = std::move(out.error_);
+            out.clear();
+            out.error_ = std::move(error);
+            return false;
+        }
+        if (out.code_.size() == 1 && out.code_[0].op == Op::Load) {
+            out.variable_ = out.code_[0].arg;
+        }
+        return true;
+    }
+    
+private:
+    bool parse() {
+        if (!ternary()) return false;
+        skipSpace();
+        if (pos_ < source_.size()) return fail("unexpected '" + std::string(1, source_[pos_]) + "'");
+        if (maxDepth_ > static_cast<int>(Expression::MaxStackDepth)) return fail("expression nests too deeply");
+        return true;
+    }
+    
+    bool ternary() {
+        if (!logicalOr()) return false;
+        if (!match("?")) return true;
+        
+        std::size_t jumpToElse = emit(Op::JumpIfFalse, 0, -1);
+        if (!ternary()) return false;
+        if (!match(":")) return fail("expected ':'");
+        std::size_t jumpToEnd = emit(Op::Jump, 0, 0);
+        // Only one branch leaves its value on the stack
+        --depth_;
+        out_.code_[jumpToElse].arg = static_cast<std::uint32_t>(out_.code_.size());
+        if (!ternary()) return false;
+        out_.code_[jumpToEnd].arg = static_cast<std::uint32_t>(out_.code_.size());
+        return true;
+    }
+    
+    bool logicalOr() {
+        if (!logicalAnd()) return false;
+        while (match("||")) {
+            if (!logicalAnd()) return false;
+            emit(Op::Or, 0, -1);
+        }
+        return true;
+    }
+    
+    bool logicalAnd() {
+        if (!equality()) return false;
+        while (match("&&")) {
+            if (!equality()) return false;
+            emit(Op::And, 0, -1);
+        }
+        return true;
+    }
+    
+    bool equality() {
+        if (!comparison()) return false;
+        for (;;) {
+            Op op;
+            if (match("==")) op = Op::Equal;
+            else if (match("!=")) op = Op::NotEqual;
+            else return true;
+            if (!comparison()) return false;
+            emit(op, 0, -1);
+        }
+    }
+    
+    bool comparison() {
+        if (!additive()) return false;
+        for (;;) {
+            Op op;
+            if (match("<=")) op = Op::LessEqual;
+            else if (match(">=")) op = Op::GreaterEqual;
+            else if (match("<")) op = Op::Less;
+            else if (match(">")) op = Op::Greater;
+            else return true;
+            if (!additive()) return false;
+            emit(op, 0, -1);
+        }
+    }
+    
+    bool additive() {
+        if (!multiplicative()) return false;
+        for (;;) {
+            Op op;
+            if (match("+")) op = Op::Add;
+            else if (match("-")) op = Op::Subtract;
+            else return true;
+            if (!multiplicative()) return false;
+            emit(op, 0, -1);
+        }
+    }
+    
+    bool multiplicative() {
+        if (!unary()) return false;
+        for (;;) {
+            Op op;
+            if (match("*")) op = Op::Multiply;
+            else if (match("/")) op = Op::Divide;
+            else if (match("%")) op = Op::Modulo;
+            else return true;
+            if (!unary()) return false;
+            emit(op, 0, -1);
+        }
+    }
+    
+    bool unary() {
+        if (match("-")) {
+            if (!unary()) return false;
+            emit(Op::Negate, 0, 0);
+            return true;
+        }
+        if (match("!")) {
+            if (!unary()) return false;
+            emit(Op::Not, 0, 0);
+            return true;
+        }
+        return primary();
+    }
+    
+    bool primary() {
+        skipSpace();
+        if (pos_ >= source_.size()) return fail("unexpected end");
+        
+        const char c = source_[pos_];
+        if (c == '(') {
+            ++pos_;
+            if (!ternary()) return false;
+            return match(")") || fail("expected ')'");
+        }
+        if (c == '"') return stringLiteral();
+        if (std::isdigit(static_cast<unsigned char>(c)) ||
+            (c == '.' && pos_ + 1 < source_.size() && std::isdigit(static_cast<unsigned char>(source_[pos_ + 1])))) {
+            char* end = nullptr;
+            const double value = std::strtod(source_.c_str() + pos_, &end);
+            pos_ = static_cast<std::size_t>(end - source_.c_str());
+            emit(Op::PushNumber, static_cast<std::uint32_t>(out_.numbers_.size()), 1);
+            out_.numbers_.push_back(value);
+            return true;
+        }
+        if (std::isalpha(static_cast<unsigned char>(c)) || c == '_') {
+            const std::size_t start = pos_;
+            while (pos_ < source_.size() &&
+                   (std::isalnum(static_cast<unsigned char>(source_[pos_])) || source_[pos_] == '_' || source_[pos_] == '.')) {
+                ++pos_;
+            }
+            const std::string name = source_.substr(start, pos_ - start);
+            if (match("(")) return function(name);
+            if (name == "true" || name == "false") {
+                emit(Op::PushBool, name == "true" ? 1 : 0, 1);
+                return true;
+            }
+            return variable(name);
+        }
+        return fail("unexpected '" + std::string(1, c) + "'");
+    }
+    
+    bool stringLiteral() {
+        std::string text;
+        for (++pos_; pos_ < source_.size() && source_[pos_] != '"'; ++pos_) {
+            if (source_[pos_] == '\\' && pos_ + 1 < source_.size()) ++pos_;
+            text += source_[pos_];
+        }
+        if (pos_ >= source_.size()) return fail("unterminated string");
+        ++pos_;
+        emit(Op::PushString, static_cast<std::uint32_t>(out_.strings_.size()), 1);
+        out_.strings_.push_back(std::move(text));
+        return true;
+    }
+    
+    bool function(const std::string& name) {
+        Op op;
+        int arguments;
+        if (name == "abs") { op = Op::Abs; arguments = 1; }
+        else if (name == "round") { op = Op::Round; arguments = 1; }
+        else if (name == "min") { op = Op::Min; arguments = 2; }
+        else if (name == "max") { op = Op::Max; arguments = 2; }
+        else return fail("unknown function '" + name + "'");
+        
+        for (int i = 0; i < arguments; ++i) {
+            if (i > 0 && !match(",")) return fail("expected ','");
+            if (!ternary()) return false;
+        }
+        if (!match(")")) return fail("expected ')'");
+        emit(op, 0, 1 - arguments);
+        return true;
+    }
+    
+    bool variable(const std::string& name) {
+        const VariableId id = resolve_(name);
+        // Unknown to compileExisting(): not an error, just not ready yet
+        if (id == InvalidVariableId) return false;
+        bool known = false;
+        for (VariableId input : out_.inputs_) known = known || input == id;
+        if (!known) out_.inputs_.push_back(id);
+        emit(Op::Load, id, 1);
+        return true;
+    }
+    
+    std::size_t emit(Op op, std::uint32_t arg, int stackEffect) {
+        out_.code_.push_back({op, arg});
+        depth_ += stackEffect;
+        maxDepth_ = std::max(maxDepth_, depth_);
+        return out_.code_.size() - 1;
+    }
+    
+    void skipSpace() {
+        while (pos_ < source_.size() && std::isspace(static_cast<unsigned char>(source_[pos_]))) ++pos_;
+    }
+    
+    bool match(const char* token) {
+        skipSpace();
+        std::size_t length = std::char_traits<char>::length(token);
+        if (source_.compare(pos_, length, token) != 0) return false;
+        // "!" must not eat the start of "!=", nor "<" / ">" the start of "<=" / ">="
+        if (length == 1 && (token[0] == '!' || token[0] == '<' || token[0] == '>') &&
+            pos_ + 1 < source_.size() && source_[pos_ + 1] == '=') {
+            return false;
+        }
+        pos_ += length;
+        return true;
+    }
+    
+    bool fail(const std::string& message) {
+        if (out_.error_.empty()) {
+            out_.error_ = message + " at " + std::to_string(pos_);
+        }
+        return false;
+    }
+    
+    const std::string& source_;
+    Expression& out_;
+    const Resolver& resolve_;
+    std::size_t pos_ = 0;
+    int depth_ = 0;
+    int maxDepth_ = 0;
+};
+
+namespace {
+
+struct Operand {
+    enum Kind : std::uint8_t { Number, Bool, Text } kind;
+    double number;
+    const std::string* text;
+};
+
+bool loadOperand(const VariableDatabase::ValueType& value, Operand& out) {
+    return std::visit([&out](const auto& v) {
+        using T = std::decay_t<decltype(v)>;
+        if constexpr (std::is_same_v<T, std::string>) {
+            out = {Operand::Text, 0.0, &v};
+        } else if constexpr (std::is_same_v<T, bool>) {
+            out = {Operand::Bool, v ? 1.0 : 0.0, nullptr};
+        } else {
+            out = {Operand::Number, static_cast<double>(v), nullptr};
+        }
+        return true;
+    }, value);
+}
+
+} // namespace
+
+std::string Expression::markLegacy(const std::string& source) {
+    // Names stand in for any variable, so nothing is interned
+    Expression parsed;
+    const bool expression = !source.empty() && source[0] != Marker &&
+        ExpressionParser::compile(parsed, Marker + source, [](const std::string&) { return VariableId(0); }) &&
+        parsed.variable() == InvalidVariableId;
+    return expression ? Marker + source : source;
+}
+
+bool Expression::compile(const std::string& source, VariableDatabase& db) {
+    return ExpressionParser::compile(*this, source,
+                                     [&db](const std::string& name) { return db.resolveId(name); });
+}
+
+bool Expression::compileExisting(const std::string& source, const VariableDatabase& db) {
+    return ExpressionParser::compile(*this, source,
+                                     [&db](const std::string& name) { return db.findId(name); });
+}
+
+void Expression::clear() {
+    code_.clear();
+    numbers_.clear();
+    strings_.clear();
+    inputs_.clear();
+    variable_ = InvalidVariableId;
+    error_.clear();
+}
+
+std::optional<VariableDatabase::ValueType> Expression::evaluate(const VariableDatabase& db) const {
+    if (variable_ != InvalidVariableId) {
+        if (const VariableDatabase::ValueType* value = db.findValue(variable_)) {
+            return *value;
+        }
+        return std::nullopt;
+    }
+    if (code_.empty()) return std::nullopt;
+    
+    Operand stack[MaxStackDepth];
+    std::size_t top = 0;
+    auto number = [](const Operand& operand, double& out) {
+        out = operand.number;
+        return operand.kind != Operand::Text;
+    };
+    
+    for (std::size_t pc = 0; pc < code_.size(); ++pc) {
+        const Instruction& instruction = code_[pc];
+        switch (instruction.op) {
+            case Op::PushNumber:
+                stack[top++] = {Operand::Number, numbers_[instruction.arg], nullptr};
+                break;
+            case Op::PushString:
+                stack[top++] = {Operand::Text, 0.0, &strings_[instruction.arg]};
+                break;
+            case Op::PushBool:
+                stack[top++] = {Operand::Bool, instruction.arg ? 1.0 : 0.0, nullptr};
+                break;
+            case Op::Load: {
+                const VariableDatabase::ValueType* value = db.findValue(instruction.arg);
+                if (!value) return std::nullopt;
+                loadOperand(*value, stack[top++]);
+                break;
+            }
+            case Op::Negate:
+            case Op::Abs:
+            case Op::Round: {
+                double a;
+                if (!number(stack[top - 1], a)) return std::nullopt;
+                const double result = instruction.op == Op::Negate ? -a
+                                    : instruction.op == Op::Abs ? std::fabs(a) : std::round(a);
+                stack[top - 1] = {Operand::Number, result, nullptr};
+                break;
+            }
+            case Op::Not: {
+                double a;
+                if (!number(stack[top - 1], a)) return std::nullopt;
+                stack[top - 1] = {Operand::Bool, a == 0.0 ? 1.0 : 0.0, nullptr};
+                break;
+            }
+            case Op::Equal:
+            case Op::NotEqual: {
+                const Operand& a = stack[top - 2];
+                const Operand& b = stack[top - 1];
+                if ((a.kind == Operand::Text) != (b.kind == Operand::Text)) return std::nullopt;
+                bool equal = a.kind == Operand::Text ? *a.text == *b.text : a.number == b.number;
+                stack[--top - 1] = {Operand::Bool, equal == (instruction.op == Op::Equal) ? 1.0 : 0.0, nullptr};
+                break;
+            }
+            case Op::Jump:
+                pc = instruction.arg - 1;
+                break;
+            case Op::JumpIfFalse: {
+                double condition;
+                if (!number(stack[--top], condition)) return std::nullopt;
+                if (condition == 0.0) pc = instruction.arg - 1;
+                break;
+            }
+            default: {
+                double a, b;
+                if (!number(stack[top - 2], a) || !number(stack[top - 1], b)) return std::nullopt;
+                Operand result{Operand::Number, 0.0, nullptr};
+                switch (instruction.op) {
+                    case Op::Add: result.number = a + b; break;
+                    case Op::Subtract: result.number = a - b; break;
+                    case Op::Multiply: result.number = a * b; break;
+                    case Op::Divide: result.number = a / b; break;
+                    case Op::Modulo: result.number = std::fmod(a, b); break;
+                    case Op::Min: result.number = std::min(a, b); break;
+                    case Op::Max: result.number = std::max(a, b); break;
+                    default: {
+                        bool truth = false;
+                        switch (instruction.op) {
+                            case Op::Less: truth = a < b; break;
+                            case Op::LessEqual: truth = a <= b; break;
+                            case Op::Greater: truth = a > b; break;
+                            case Op::GreaterEqual: truth = a >= b; break;
+                            case Op::And: truth = a != 0.0 && b != 0.0; break;
+                            case Op::Or: truth = a != 0.0 || b != 0.0; break;
+                            default: break;
+                        }
+                        result = {Operand::Bool, truth ? 1.0 : 0.0, nullptr};
+                        break;
+                    }
+                }
+                stack[--top - 1] = result;
+                break;
+            }
+        }
+    }
+    
+    const Operand& result = stack[0];
+    switch (result.kind) {
+        case Operand::Text: return VariableDatabase::ValueType(*result.text);
+        case Operand::Bool: return VariableDatabase::ValueType(result.number != 0.0);
+        default: return VariableDatabase::ValueType(result.number);
+    }
+}
+
+} // namespace xsmall_hmi
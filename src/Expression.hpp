@@ -0,0 +1,77 @@
+#pragma once
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+#include "VariableDatabase.hpp"
+
+namespace xsmall_hmi {
+
+// A binding expression such as `=temp_c * 1.8 + 32` or `=pumpA && !fault`:
+// the text after the leading '=' is parsed once into stack bytecode over
+// resolved variable ids.
+//
+// Operands are numbers, true/false, "strings" and variable names
+// ([A-Za-z_][A-Za-z0-9_.]*). Operators, loosest first: ?:, ||, &&,
+// == !=, < <= > >=, + -, * / %, unary - and !. Functions: abs, round,
+// min, max. Variables of any numeric type and bools compute as doubles;
+// strings only compare with == and !=.
+//
+// A source without the '=' names one variable, whatever characters it
+// contains ("Tank 1", "temp-c"), and evaluates to that variable's value
+// unchanged, so plain bindings cost no more than before.
+class Expression {
+public:
+    static constexpr char Marker = '=';
+    
+    // Bindings written before the marker existed: the source as an
+    // expression if it parses as one that is more than a single name,
+    // otherwise as a plain name
+    static std::string markLegacy(const std::string& source);
+    
+    // Interns every variable the source reads
+    bool compile(const std::string& source, VariableDatabase& db);
+    // Succeeds only once every variable the source reads exists
+    bool compileExisting(const std::string& source, const VariableDatabase& db);
+    void clear();
+    
+    bool isCompiled() const { return !code_.empty(); }
+    // Parse error of the last compile, empty if it parsed
+    const std::string& error() const { return error_; }
+    
+    // Distinct variables read, in order of first use
+    const std::vector<VariableId>& inputs() const { return inputs_; }
+    // The variable of a single-variable expression, otherwise invalid
+    VariableId variable() const { return variable_; }
+    
+    // Nothing if a variable is missing or an operand has the wrong type.
+    // Computed results are double, bool or string.
+    std::optional<VariableDatabase::ValueType> evaluate(const VariableDatabase& db) const;
+    
+private:
+    friend class ExpressionParser;
+    
+    enum class Op : std::uint8_t {
+        PushNumber, PushString, PushBool, Load,
+        Negate, Not, Add, Subtract, Multiply, Divide, Modulo,
+        Less, LessEqual, Greater, GreaterEqual, Equal, NotEqual, And, Or,
+        Abs, Round, Min, Max,
+        Jump, JumpIfFalse
+    };
+    
+    struct Instruction {
+        Op op;
+        std::uint32_t arg;
+    };
+    
+    static constexpr std::size_t MaxStackDepth = 32;
+    
+    std::vector<Instruction> code_;
+    std::vector<double> numbers_;
+    std::vector<std::string> strings_;
+    std::vector<VariableId> inputs_;
+    VariableId variable_ = InvalidVariableId;
+    std::string error_;
+};
+
+} // namespace xsmall_hmi
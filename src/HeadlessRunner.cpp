@@ -0,0 +1,138 @@
+#include "HeadlessRunner.hpp"
+#include "ResourceCache.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <numeric>
+
+namespace xsmall_hmi {
+
+HeadlessRunner::HeadlessRunner(const sf::Vector2u& size) {
+    ready_ = target_.resize(size);
+    variableDatabase_.setNotificationMode(VariableDatabase::NotificationMode::Deferred);
+}
+
+void HeadlessRunner::addObject(VisualObject* object) {
+    bindings_.track(object);
+}
+
+void HeadlessRunner::setUpdateThreads(std::size_t threads) {
+    bindings_.setThreadPool(nullptr);
+    updatePool_.reset();
+    if (threads > 0) {
+        updatePool_ = std::make_unique<ThreadPool>(threads);
+        bindings_.setThreadPool(updatePool_.get());
+    }
+}
+
+void HeadlessRunner::populate(std::size_t objectCount, std::size_t variableCount) {
+    variableCount = std::max<std::size_t>(variableCount, 1);
+    for (std::size_t i = variables_.size(); i < variableCount; ++i) {
+        VariableId id = variableDatabase_.resolveId("tag_" + std::to_string(i));
+        variableDatabase_.setVariable(id, 0.0f);
+        variables_.push_back(id);
+    }
+    
+    const sf::Vector2f cell(60, 40);
+    const std::size_t columns = std::max<std::size_t>(1, static_cast<std::size_t>(target_.getSize().x / cell.x));
+    
+    for (std::size_t i = 0; i < objectCount; ++i) {
+        std::string id = "obj_" + std::to_string(objects_.size());
+        const std::string& tag = variableDatabase_.getName(variables_[i % variables_.size()]);
+        sf::Vector2f pos(static_cast<float>(i % columns) * cell.x,
+                         static_cast<float>((i / columns) % 20) * cell.y);
+        
+        VisualObject* object = nullptr;
+        switch (i % 6) {
+            case 0: object = objects_.create<RectangleObject>(id); break;
+            case 1: {
+                auto* text = objects_.create<TextObject>(id);
+                text->setText("Tag");
+                text->setVariableBinding(variableDatabase_, tag);
+                object = text;
+                break;
+            }
+            case 2: {
+                auto* button = objects_.create<ButtonObject>(id);
+                button->setText("Go");
+                object = button;
+                break;
+            }
+            case 3: object = objects_.create<InputFieldObject>(id); break;
+            case 4: {
+                auto* graph = objects_.create<HistoryGraphObject>(id);
+                graph->setVariableBinding(variableDatabase_, tag);
+                object = graph;
+                break;
+            }
+            default: {
+                auto* line = objects_.create<LineObject>(id);
+                line->setPoints(pos, pos + cell);
+                object = line;
+                break;
+            }
+        }
+        object->setPosition(pos);
+        object->setSize(cell - sf::Vector2f(6, 6));
+        addObject(object);
+    }
+}
+
+HeadlessRunner::FrameStats HeadlessRunner::run(std::size_t frames, const FrameHook& beforeFrame) {
+    std::vector<double> frameTimes;
+    frameTimes.reserve(frames);
+    
+    for (std::size_t frame = 0; frame < frames; ++frame) {
+        auto start = std::chrono::steady_clock::now();
+        
+        if (beforeFrame) {
+            beforeFrame(frame, variableDatabase_);
+        }
+        variableDatabase_.applyPublished();
+        variableDatabase_.dispatchNotifications();
+        bindings_.updateDirty();
+        if (ResourceCache::instance().processLoadedImages() > 0) {
+            for (VisualObject* obj : objects_) {
+                if (auto* image = objectCast<ImageObject>(obj)) {
+                    image->refreshImage();
+                }
+            }
+        }
+        renderFrame();
+        
+        auto end = std::chrono::steady_clock::now();
+        frameTimes.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+    }
+    return computeStats(std::move(frameTimes));
+}
+
+void HeadlessRunner::renderFrame() {
+    target_.clear(sf::Color(250, 250, 250));
+    sceneRenderer_.render(target_, objects_);
+    target_.display();
+}
+
+bool HeadlessRunner::saveFrame(const std::string& filename) const {
+    return target_.getTexture().copyToImage().saveToFile(filename);
+}
+
+HeadlessRunner::FrameStats HeadlessRunner::computeStats(std::vector<double> frameTimes) {
+    FrameStats stats;
+    stats.frames = frameTimes.size();
+    if (frameTimes.empty()) return stats;
+    
+    std::sort(frameTimes.begin(), frameTimes.end());
+    auto percentile = [&frameTimes](double p) {
+        std::size_t rank = static_cast<std::size_t>(std::ceil(p * frameTimes.size()));
+        return frameTimes[std::min(frameTimes.size() - 1, rank > 0 ? rank - 1 : 0)];
+    };
+    
+    stats.mean = std::accumulate(frameTimes.begin(), frameTimes.end(), 0.0) / frameTimes.size();
+    stats.p50 = percentile(0.50);
+    stats.p90 = percentile(0.90);
+    stats.p99 = percentile(0.99);
+    stats.max = frameTimes.back();
+    return stats;
+}
+
+} // namespace xsmall_hmi
@@ -0,0 +1,67 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "VisualObject.hpp"
+#include "VariableDatabase.hpp"
+#include "BindingTracker.hpp"
+#include "SceneRenderer.hpp"
+#include "SceneStore.hpp"
+#include "ThreadPool.hpp"
+
+namespace xsmall_hmi {
+
+// Renders a scene into an offscreen sf::RenderTexture with the same
+// update/render path as the Editor, without opening a window, and reports
+// frame-time percentiles.
+class HeadlessRunner {
+public:
+    // Frame times in milliseconds
+    struct FrameStats {
+        std::size_t frames = 0;
+        double mean = 0.0;
+        double p50 = 0.0;
+        double p90 = 0.0;
+        double p99 = 0.0;
+        double max = 0.0;
+    };
+    
+    using FrameHook = std::function<void(std::size_t frame, VariableDatabase& db)>;
+    
+    explicit HeadlessRunner(const sf::Vector2u& size);
+    
+    bool isReady() const { return ready_; }
+    VariableDatabase& getDatabase() { return variableDatabase_; }
+    
+    SceneStore& getObjects() { return objects_; }
+    // Registers an object created in getObjects() once its binding is set
+    void addObject(VisualObject* object);
+    // Synthetic screen: a grid of mixed object types bound to `variableCount` tags
+    void populate(std::size_t objectCount, std::size_t variableCount);
+    const std::vector<VariableId>& getVariables() const { return variables_; }
+    // Worker threads helping with large update phases; 0 updates serially
+    void setUpdateThreads(std::size_t threads);
+    
+    // The hook runs before each frame, typically to write variables
+    FrameStats run(std::size_t frames, const FrameHook& beforeFrame = {});
+    bool saveFrame(const std::string& filename) const;
+    
+    static FrameStats computeStats(std::vector<double> frameTimes);
+    
+private:
+    void renderFrame();
+    
+    sf::RenderTexture target_;
+    bool ready_ = false;
+    VariableDatabase variableDatabase_;
+    BindingTracker bindings_{variableDatabase_};
+    SceneRenderer sceneRenderer_;
+    SceneStore objects_;
+    std::vector<VariableId> variables_;
+    std::unique_ptr<ThreadPool> updatePool_;
+};
+
+} // namespace xsmall_hmi
@@ -0,0 +1,432 @@
+#include "Historian.hpp"
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <type_traits>
+#include <variant>
+
+namespace xsmall_hmi {
+
+namespace {
+
+const char FileMagic[4] = {'X', 'H', 'H', 'S'};
+const std::uint32_t FileVersion = 1;
+const std::size_t FileHeaderSize = 8;
+const std::size_t RecordHeaderSize = 5;
+const std::size_t ChunkHeaderSize = 24;
+
+template<typename T>
+void put(std::vector<std::uint8_t>& out, const T& value) {
+    std::uint8_t bytes[sizeof(T)];
+    std::memcpy(bytes, &value, sizeof(T));
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+template<typename T>
+T get(const std::uint8_t* data) {
+    T value;
+    std::memcpy(&value, data, sizeof(T));
+    return value;
+}
+
+void putVarint(std::vector<std::uint8_t>& out, std::uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<std::uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<std::uint8_t>(value));
+}
+
+bool getVarint(const std::uint8_t*& data, const std::uint8_t* end, std::uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64 && data < end; shift += 7) {
+        std::uint8_t byte = *data++;
+        value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+std::uint64_t zigzag(std::int64_t value) {
+    return (static_cast<std::uint64_t>(value) << 1) ^ static_cast<std::uint64_t>(value >> 63);
+}
+
+std::int64_t unzigzag(std::uint64_t value) {
+    return static_cast<std::int64_t>(value >> 1) ^ -static_cast<std::int64_t>(value & 1);
+}
+
+std::int64_t toMicroseconds(double seconds) {
+    return static_cast<std::int64_t>(std::llround(seconds * 1e6));
+}
+
+std::uint64_t toBits(double value) {
+    std::uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+double fromBits(std::uint64_t bits) {
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+} // namespace
+
+Historian::Historian(VariableDatabase& db, std::size_t samplesPerChunk)
+    : db_(db), samplesPerChunk_(samplesPerChunk > 0 ? samplesPerChunk : 1) {
+}
+
+Historian::~Historian() {
+    close();
+}
+
+bool Historian::open(const std::string& path) {
+    close();
+    path_ = path;
+    
+    std::error_code error;
+    std::uint64_t existingSize = std::filesystem::exists(path_, error)
+        ? std::filesystem::file_size(path_, error) : 0;
+    
+    std::uint64_t validSize = loadIndex();
+    if (existingSize > 0 && validSize == 0) {
+        // Not a historian file; never append to it
+        path_.clear();
+        return false;
+    }
+    if (validSize < existingSize) {
+        // Drop a torn record left by an interrupted write before appending
+        map_.close();
+        std::filesystem::resize_file(path_, validSize, error);
+    }
+    
+    file_ = std::fopen(path_.c_str(), "ab");
+    if (!file_) return false;
+    
+    fileSize_ = validSize;
+    if (fileSize_ == 0) {
+        std::vector<std::uint8_t> header(FileMagic, FileMagic + 4);
+        put(header, FileVersion);
+        if (std::fwrite(header.data(), 1, header.size(), file_) != header.size()) {
+            close();
+            return false;
+        }
+        std::fflush(file_);
+        fileSize_ = header.size();
+    }
+    return true;
+}
+
+void Historian::close() {
+    writeHook_.reset();
+    recordings_.clear();
+    if (file_) {
+        flush();
+        std::fclose(file_);
+        file_ = nullptr;
+    }
+    map_.close();
+    fileSize_ = 0;
+    series_.clear();
+    seriesIds_.clear();
+    chunks_.clear();
+}
+
+bool Historian::record(const std::string& name, const SubscribeOptions& options) {
+    if (!file_) return false;
+    
+    // Sampled from the write itself: a deferred or rate-limited subscriber
+    // would see one value per dispatch, stamped with the dispatch time
+    const VariableId id = db_.resolveId(name);
+    if (id >= recordings_.size()) recordings_.resize(id + 1);
+    Recording& recording = recordings_[id];
+    recording = Recording{};
+    recording.active = true;
+    recording.series = seriesFor(name);
+    recording.options = options;
+    
+    if (!writeHook_.isActive()) {
+        writeHook_ = db_.addWriteHook([this](VariableId variable, const VariableDatabase::ValueType& value,
+                                             double time) {
+            onWrite(variable, value, time);
+        });
+    }
+    return true;
+}
+
+void Historian::onWrite(VariableId id, const VariableDatabase::ValueType& value, double time) {
+    if (id >= recordings_.size() || !recordings_[id].active) return;
+    
+    Recording& recording = recordings_[id];
+    std::visit([&](const auto& v) {
+        using T = std::decay_t<decltype(v)>;
+        if constexpr (!std::is_same_v<T, std::string>) {
+            const double number = static_cast<double>(v);
+            if (!passesFilter(recording, time, number)) return;
+            
+            append(recording.series, time, number);
+            recording.stored = true;
+            recording.lastTime = time;
+            recording.lastValue = number;
+        }
+    }, value);
+}
+
+bool Historian::passesFilter(const Recording& recording, double time, double value) {
+    const SubscribeOptions& options = recording.options;
+    if (!recording.stored) return true;
+    if (options.maxRate > 0.0 && time - recording.lastTime < 1.0 / options.maxRate) return false;
+    
+    const double delta = std::abs(value - recording.lastValue);
+    switch (options.deadband) {
+        case SubscribeOptions::Deadband::Absolute:
+            return delta > options.deadbandValue;
+        case SubscribeOptions::Deadband::Percent:
+            return delta > std::abs(recording.lastValue) * options.deadbandValue / 100.0;
+        case SubscribeOptions::Deadband::None:
+            break;
+    }
+    return !options.skipUnchanged || delta != 0.0;
+}
+
+void Historian::append(const std::string& name, double time, double value) {
+    if (!file_) return;
+    append(seriesFor(name), time, value);
+}
+
+void Historian::append(std::uint32_t series, double time, double value) {
+    auto& pending = series_[series].pending;
+    pending.push_back({time, value});
+    if (pending.size() >= samplesPerChunk_) {
+        sealChunk(series);
+    }
+}
+
+void Historian::flush() {
+    for (std::uint32_t series = 0; series < series_.size(); ++series) {
+        sealChunk(series);
+    }
+}
+
+std::size_t Historian::query(const std::string& name, double from, double to,
+                             std::vector<Sample>& out) const {
+    auto it = seriesIds_.find(name);
+    if (it == seriesIds_.end()) return 0;
+    
+    const Series& series = series_[it->second];
+    std::size_t before = out.size();
+    std::vector<Sample> decoded;
+    
+    for (std::uint32_t index : series.chunks) {
+        const ChunkInfo& chunk = chunks_[index];
+        if (chunk.lastTime < from || chunk.firstTime > to) continue;
+        
+        const std::uint8_t* data = mappedData(chunk.offset + chunk.size);
+        decoded.clear();
+        if (!data || !decodeSamples(data + chunk.offset, chunk.size, chunk.count, decoded)) continue;
+        
+        for (const auto& sample : decoded) {
+            if (sample.time >= from && sample.time <= to) out.push_back(sample);
+        }
+    }
+    
+    for (const auto& sample : series.pending) {
+        if (sample.time >= from && sample.time <= to) out.push_back(sample);
+    }
+    return out.size() - before;
+}
+
+double Historian::now() {
+    return VariableDatabase::now();
+}
+
+std::uint32_t Historian::seriesFor(const std::string& name) {
+    auto it = seriesIds_.find(name);
+    if (it != seriesIds_.end()) return it->second;
+    
+    std::uint32_t id = static_cast<std::uint32_t>(series_.size());
+    series_.push_back({name, {}, {}});
+    seriesIds_.emplace(name, id);
+    
+    std::vector<std::uint8_t> payload;
+    put(payload, id);
+    payload.insert(payload.end(), name.begin(), name.end());
+    writeRecord(SeriesRecord, payload);
+    return id;
+}
+
+void Historian::sealChunk(std::uint32_t series) {
+    auto& pending = series_[series].pending;
+    if (pending.empty() || !file_) return;
+    
+    std::vector<std::uint8_t> payload;
+    put(payload, series);
+    put(payload, static_cast<std::uint32_t>(pending.size()));
+    put(payload, pending.front().time);
+    put(payload, pending.back().time);
+    
+    encodeBuffer_.clear();
+    encodeSamples(pending, encodeBuffer_);
+    payload.insert(payload.end(), encodeBuffer_.begin(), encodeBuffer_.end());
+    
+    ChunkInfo chunk;
+    chunk.offset = fileSize_ + RecordHeaderSize + ChunkHeaderSize;
+    chunk.size = static_cast<std::uint32_t>(encodeBuffer_.size());
+    chunk.count = static_cast<std::uint32_t>(pending.size());
+    chunk.firstTime = pending.front().time;
+    chunk.lastTime = pending.back().time;
+    
+    if (writeRecord(ChunkRecord, payload)) {
+        series_[series].chunks.push_back(static_cast<std::uint32_t>(chunks_.size()));
+        chunks_.push_back(chunk);
+        pending.clear();
+    }
+}
+
+bool Historian::writeRecord(RecordType type, const std::vector<std::uint8_t>& payload) {
+    if (!file_) return false;
+    
+    std::vector<std::uint8_t> header;
+    header.push_back(type);
+    put(header, static_cast<std::uint32_t>(payload.size()));
+    
+    bool ok = std::fwrite(header.data(), 1, header.size(), file_) == header.size() &&
+              std::fwrite(payload.data(), 1, payload.size(), file_) == payload.size();
+    std::fflush(file_);
+    if (ok) {
+        fileSize_ += header.size() + payload.size();
+    }
+    return ok;
+}
+
+std::uint64_t Historian::loadIndex() {
+    if (!map_.open(path_)) return 0;
+    
+    const std::uint8_t* data = map_.data();
+    std::size_t size = map_.size();
+    if (size < FileHeaderSize || std::memcmp(data, FileMagic, 4) != 0 ||
+        get<std::uint32_t>(data + 4) != FileVersion) {
+        map_.close();
+        return 0;
+    }
+    
+    std::size_t offset = FileHeaderSize;
+    while (offset + RecordHeaderSize <= size) {
+        std::uint8_t type = data[offset];
+        std::uint32_t length = get<std::uint32_t>(data + offset + 1);
+        const std::uint8_t* payload = data + offset + RecordHeaderSize;
+        if (offset + RecordHeaderSize + length > size) break;
+        
+        if (type == SeriesRecord && length >= 4) {
+            std::uint32_t id = get<std::uint32_t>(payload);
+            std::string name(reinterpret_cast<const char*>(payload + 4), length - 4);
+            if (id != series_.size()) break;
+            series_.push_back({name, {}, {}});
+            seriesIds_.emplace(name, id);
+        } else if (type == ChunkRecord && length >= ChunkHeaderSize) {
+            std::uint32_t series = get<std::uint32_t>(payload);
+            if (series >= series_.size()) break;
+            
+            ChunkInfo chunk;
+            chunk.count = get<std::uint32_t>(payload + 4);
+            chunk.firstTime = get<double>(payload + 8);
+            chunk.lastTime = get<double>(payload + 16);
+            chunk.offset = offset + RecordHeaderSize + ChunkHeaderSize;
+            chunk.size = length - static_cast<std::uint32_t>(ChunkHeaderSize);
+            series_[series].chunks.push_back(static_cast<std::uint32_t>(chunks_.size()));
+            chunks_.push_back(chunk);
+        } else {
+            break;
+        }
+        offset += RecordHeaderSize + length;
+    }
+    return offset;
+}
+
+const std::uint8_t* Historian::mappedData(std::uint64_t end) const {
+    // Chunks sealed since the last query are past the end of the old mapping
+    if (!map_.isOpen() || map_.size() < end) {
+        map_.open(path_);
+    }
+    return map_.isOpen() && map_.size() >= end ? map_.data() : nullptr;
+}
+
+void Historian::encodeSamples(const std::vector<Sample>& samples, std::vector<std::uint8_t>& out) {
+    std::int64_t previousTime = 0;
+    std::int64_t previousDelta = 0;
+    std::uint64_t previousBits = 0;
+    
+    for (std::size_t i = 0; i < samples.size(); ++i) {
+        std::int64_t time = toMicroseconds(samples[i].time);
+        std::uint64_t bits = toBits(samples[i].value);
+        
+        if (i == 0) {
+            put(out, time);
+            put(out, bits);
+        } else {
+            std::int64_t delta = time - previousTime;
+            putVarint(out, zigzag(delta - previousDelta));
+            previousDelta = delta;
+            
+            // Only the bytes that differ from the previous value are stored
+            std::uint64_t diff = bits ^ previousBits;
+            if (diff == 0) {
+                out.push_back(0);
+            } else {
+                int leading = 0;
+                while (!(diff >> (56 - 8 * leading) & 0xff)) ++leading;
+                int trailing = 0;
+                while (!(diff >> (8 * trailing) & 0xff)) ++trailing;
+                int meaningful = 8 - leading - trailing;
+                
+                out.push_back(static_cast<std::uint8_t>((leading << 4) | meaningful));
+                for (int b = meaningful - 1; b >= 0; --b) {
+                    out.push_back(static_cast<std::uint8_t>(diff >> (8 * (trailing + b))));
+                }
+            }
+        }
+        previousTime = time;
+        previousBits = bits;
+    }
+}
+
+bool Historian::decodeSamples(const std::uint8_t* data, std::size_t size, std::uint32_t count,
+                              std::vector<Sample>& out) {
+    const std::uint8_t* end = data + size;
+    std::int64_t time = 0;
+    std::int64_t delta = 0;
+    std::uint64_t bits = 0;
+    
+    for (std::uint32_t i = 0; i < count; ++i) {
+        if (i == 0) {
+            if (end - data < 16) return false;
+            time = get<std::int64_t>(data);
+            bits = get<std::uint64_t>(data + 8);
+            data += 16;
+        } else {
+            std::uint64_t encoded;
+            if (!getVarint(data, end, encoded) || data >= end) return false;
+            delta += unzigzag(encoded);
+            time += delta;
+            
+            std::uint8_t control = *data++;
+            if (control != 0) {
+                int leading = control >> 4;
+                int meaningful = control & 0x0f;
+                int trailing = 8 - leading - meaningful;
+                if (meaningful == 0 || trailing < 0 || end - data < meaningful) return false;
+                
+                std::uint64_t diff = 0;
+                for (int b = 0; b < meaningful; ++b) {
+                    diff = (diff << 8) | *data++;
+                }
+                bits ^= diff << (8 * trailing);
+            }
+        }
+        out.push_back({static_cast<double>(time) / 1e6, fromBits(bits)});
+    }
+    return true;
+}
+
+} // namespace xsmall_hmi
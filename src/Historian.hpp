@@ -0,0 +1,111 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "MappedFile.hpp"
+#include "VariableDatabase.hpp"
+
+namespace xsmall_hmi {
+
+// Records selected variables to an append-only file of compressed chunks and
+// answers time-range queries from a memory mapping of that file, so hours of
+// trend data can be kept without holding them in RAM.
+//
+// File layout: an 8-byte header ("XHHS" + version) followed by records of
+// [type:u8][length:u32][payload]. Series records name a series id; chunk
+// records carry up to samplesPerChunk samples of one series with
+// delta-of-delta encoded timestamps (microseconds) and XOR encoded values.
+// Integers are stored in host byte order.
+class Historian {
+public:
+    struct Sample {
+        double time;
+        double value;
+    };
+    
+    explicit Historian(VariableDatabase& db, std::size_t samplesPerChunk = 512);
+    ~Historian();
+    Historian(const Historian&) = delete;
+    Historian& operator=(const Historian&) = delete;
+    
+    bool open(const std::string& path);
+    void close();
+    bool isOpen() const { return file_ != nullptr; }
+    
+    // Samples numeric writes of the variable from now on, each at the time
+    // its source produced it. Options thin them out against the last stored
+    // sample, e.g. a deadband that stores only real movement of a noisy tag;
+    // maxRate is the most samples per second kept, later ones are dropped.
+    bool record(const std::string& name, const SubscribeOptions& options = {});
+    void append(const std::string& name, double time, double value);
+    // Seals all partially filled chunks to disk
+    void flush();
+    
+    // Appends samples with from <= time <= to, oldest first
+    std::size_t query(const std::string& name, double from, double to,
+                      std::vector<Sample>& out) const;
+    
+    static double now();
+    
+private:
+    enum RecordType : std::uint8_t {
+        SeriesRecord = 1,
+        ChunkRecord = 2
+    };
+    
+    struct Series {
+        std::string name;
+        std::vector<Sample> pending;
+        std::vector<std::uint32_t> chunks;
+    };
+    
+    struct Recording {
+        bool active = false;
+        std::uint32_t series = 0;
+        SubscribeOptions options;
+        bool stored = false;
+        double lastTime = 0.0;
+        double lastValue = 0.0;
+    };
+    
+    struct ChunkInfo {
+        std::uint64_t offset = 0;
+        std::uint32_t size = 0;
+        std::uint32_t count = 0;
+        double firstTime = 0.0;
+        double lastTime = 0.0;
+    };
+    
+    void onWrite(VariableId id, const VariableDatabase::ValueType& value, double time);
+    static bool passesFilter(const Recording& recording, double time, double value);
+    std::uint32_t seriesFor(const std::string& name);
+    void append(std::uint32_t series, double time, double value);
+    void sealChunk(std::uint32_t series);
+    bool writeRecord(RecordType type, const std::vector<std::uint8_t>& payload);
+    std::uint64_t loadIndex();
+    const std::uint8_t* mappedData(std::uint64_t end) const;
+    
+    static void encodeSamples(const std::vector<Sample>& samples, std::vector<std::uint8_t>& out);
+    static bool decodeSamples(const std::uint8_t* data, std::size_t size, std::uint32_t count,
+                              std::vector<Sample>& out);
+    
+    VariableDatabase& db_;
+    std::size_t samplesPerChunk_;
+    std::string path_;
+    std::FILE* file_ = nullptr;
+    std::uint64_t fileSize_ = 0;
+    
+    std::vector<Series> series_;
+    std::unordered_map<std::string, std::uint32_t> seriesIds_;
+    std::vector<ChunkInfo> chunks_;
+    // By variable id; recording ends with close()
+    std::vector<Recording> recordings_;
+    Subscription writeHook_;
+    std::vector<std::uint8_t> encodeBuffer_;
+    
+    mutable MappedFile map_;
+};
+
+} // namespace xsmall_hmi
@@ -0,0 +1,165 @@
+#include "HistoryBuffer.hpp"
+#include <algorithm>
+#include <limits>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define XSMALL_HMI_HISTORY_SSE 1
+#endif
+
+namespace xsmall_hmi {
+
+namespace {
+
+void spanMinMax(const float* data, std::size_t count, float& min, float& max) {
+    std::size_t i = 0;
+#ifdef XSMALL_HMI_HISTORY_SSE
+    if (count >= 8) {
+        __m128 vmin = _mm_loadu_ps(data);
+        __m128 vmax = vmin;
+        for (i = 4; i + 4 <= count; i += 4) {
+            __m128 v = _mm_loadu_ps(data + i);
+            vmin = _mm_min_ps(vmin, v);
+            vmax = _mm_max_ps(vmax, v);
+        }
+        
+        alignas(16) float lanes[4];
+        _mm_store_ps(lanes, vmin);
+        min = std::min({min, lanes[0], lanes[1], lanes[2], lanes[3]});
+        _mm_store_ps(lanes, vmax);
+        max = std::max({max, lanes[0], lanes[1], lanes[2], lanes[3]});
+    }
+#endif
+    for (; i < count; ++i) {
+        min = std::min(min, data[i]);
+        max = std::max(max, data[i]);
+    }
+}
+
+} // namespace
+
+HistoryBuffer::HistoryBuffer(std::size_t capacity)
+    : capacity_(std::max<std::size_t>(capacity, 1)),
+      times_(capacity_), values_(capacity_) {
+}
+
+void HistoryBuffer::push(double time, float value) {
+    if (count_ == capacity_) {
+        evictOldest();
+    }
+    
+    std::uint64_t sequence = nextSequence_++;
+    times_[sequence % capacity_] = time;
+    values_[sequence % capacity_] = value;
+    ++count_;
+    
+    while (!minQueue_.empty() && valueOf(minQueue_.back()) >= value) {
+        minQueue_.pop_back();
+    }
+    minQueue_.push_back(sequence);
+    while (!maxQueue_.empty() && valueOf(maxQueue_.back()) <= value) {
+        maxQueue_.pop_back();
+    }
+    maxQueue_.push_back(sequence);
+    
+    if (bucketSize_ > 0) {
+        if (buckets_.empty() || sequence >= buckets_.back().firstSequence + bucketSize_) {
+            buckets_.push_back({sequence - sequence % bucketSize_, value, value});
+        } else {
+            Bucket& bucket = buckets_.back();
+            bucket.min = std::min(bucket.min, value);
+            bucket.max = std::max(bucket.max, value);
+        }
+    }
+}
+
+void HistoryBuffer::evictOldest() {
+    std::uint64_t oldest = oldestSequence();
+    if (!minQueue_.empty() && minQueue_.front() == oldest) minQueue_.pop_front();
+    if (!maxQueue_.empty() && maxQueue_.front() == oldest) maxQueue_.pop_front();
+    
+    // A partially evicted bucket keeps its extremes until it empties
+    if (!buckets_.empty() && oldest + 1 >= buckets_.front().firstSequence + bucketSize_) {
+        buckets_.pop_front();
+    }
+    --count_;
+}
+
+void HistoryBuffer::clear() {
+    count_ = 0;
+    nextSequence_ = 0;
+    minQueue_.clear();
+    maxQueue_.clear();
+    buckets_.clear();
+}
+
+void HistoryBuffer::setCapacity(std::size_t capacity) {
+    capacity = std::max<std::size_t>(capacity, 1);
+    if (capacity == capacity_) return;
+    
+    std::size_t keep = std::min(count_, capacity);
+    std::vector<double> times(keep);
+    std::vector<float> values(keep);
+    for (std::size_t i = 0; i < keep; ++i) {
+        times[i] = timeAt(count_ - keep + i);
+        values[i] = valueAt(count_ - keep + i);
+    }
+    
+    capacity_ = capacity;
+    times_.assign(capacity_, 0.0);
+    values_.assign(capacity_, 0.0f);
+    clear();
+    for (std::size_t i = 0; i < keep; ++i) {
+        push(times[i], values[i]);
+    }
+    setBucketSize(bucketSize_);
+}
+
+void HistoryBuffer::setBucketSize(std::size_t samplesPerBucket) {
+    bucketSize_ = samplesPerBucket;
+    buckets_.clear();
+    if (bucketSize_ == 0 || count_ == 0) return;
+    
+    std::uint64_t oldest = oldestSequence();
+    for (std::uint64_t start = oldest - oldest % bucketSize_; start < nextSequence_; start += bucketSize_) {
+        std::uint64_t first = std::max(start, oldest);
+        std::uint64_t last = std::min<std::uint64_t>(start + bucketSize_, nextSequence_);
+        
+        Bucket bucket{start, std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest()};
+        rangeMinMax(static_cast<std::size_t>(first - oldest), static_cast<std::size_t>(last - oldest),
+                    bucket.min, bucket.max);
+        buckets_.push_back(bucket);
+    }
+}
+
+float HistoryBuffer::valueAt(std::size_t index) const {
+    return valueOf(oldestSequence() + index);
+}
+
+double HistoryBuffer::timeAt(std::size_t index) const {
+    return times_[(oldestSequence() + index) % capacity_];
+}
+
+float HistoryBuffer::minValue() const {
+    return minQueue_.empty() ? 0.0f : valueOf(minQueue_.front());
+}
+
+float HistoryBuffer::maxValue() const {
+    return maxQueue_.empty() ? 0.0f : valueOf(maxQueue_.front());
+}
+
+void HistoryBuffer::rangeMinMax(std::size_t first, std::size_t last, float& min, float& max) const {
+    last = std::min(last, count_);
+    if (first >= last) return;
+    
+    // The ring splits a range into at most two contiguous spans
+    std::size_t begin = static_cast<std::size_t>((oldestSequence() + first) % capacity_);
+    std::size_t length = last - first;
+    std::size_t head = std::min(length, capacity_ - begin);
+    spanMinMax(values_.data() + begin, head, min, max);
+    if (length > head) {
+        spanMinMax(values_.data(), length - head, min, max);
+    }
+}
+
+} // namespace xsmall_hmi
@@ -0,0 +1,66 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+namespace xsmall_hmi {
+
+// Fixed-capacity ring buffer of timestamped samples; once full, the oldest
+// sample is overwritten. Overall min/max are kept up to date incrementally
+// (monotonic queues), and samples are also summarised into fixed-size
+// buckets so a trend can be drawn at a cost proportional to its width in
+// columns rather than to the history depth.
+class HistoryBuffer {
+public:
+    struct Bucket {
+        std::uint64_t firstSequence;
+        float min;
+        float max;
+    };
+    
+    explicit HistoryBuffer(std::size_t capacity = 1024);
+    
+    void push(double time, float value);
+    void clear();
+    // Keeps the newest samples that still fit
+    void setCapacity(std::size_t capacity);
+    // Regroups all samples into buckets of the given size (0 disables them)
+    void setBucketSize(std::size_t samplesPerBucket);
+    
+    std::size_t size() const { return count_; }
+    std::size_t capacity() const { return capacity_; }
+    bool empty() const { return count_ == 0; }
+    
+    // Index 0 is the oldest sample
+    float valueAt(std::size_t index) const;
+    double timeAt(std::size_t index) const;
+    
+    float minValue() const;
+    float maxValue() const;
+    
+    std::size_t bucketSize() const { return bucketSize_; }
+    const std::deque<Bucket>& buckets() const { return buckets_; }
+    
+    // Min/max over [first, last) in index space, vectorised where available
+    void rangeMinMax(std::size_t first, std::size_t last, float& min, float& max) const;
+    
+private:
+    std::uint64_t oldestSequence() const { return nextSequence_ - count_; }
+    float valueOf(std::uint64_t sequence) const { return values_[sequence % capacity_]; }
+    void evictOldest();
+    
+    std::size_t capacity_;
+    std::size_t count_ = 0;
+    std::uint64_t nextSequence_ = 0;
+    std::vector<double> times_;
+    std::vector<float> values_;
+    
+    std::deque<std::uint64_t> minQueue_;
+    std::deque<std::uint64_t> maxQueue_;
+    
+    std::size_t bucketSize_ = 0;
+    std::deque<Bucket> buckets_;
+};
+
+} // namespace xsmall_hmi
@@ -0,0 +1,84 @@
+#include "Ingestion.hpp"
+#include <iostream>
+
+namespace xsmall_hmi {
+
+Ingestion::Ingestion(std::size_t queueCapacity)
+    : queueCapacity_(queueCapacity) {
+}
+
+Ingestion::~Ingestion() {
+    stop();
+}
+
+void Ingestion::addSource(std::unique_ptr<DataSource> source) {
+    Feed feed;
+    feed.source = std::move(source);
+    sources_.push_back(std::move(feed));
+}
+
+std::size_t Ingestion::start(VariableDatabase& db) {
+    stop();
+    stopping_.store(false);
+    
+    std::size_t started = 0;
+    for (auto& feed : sources_) {
+        if (!feed.source->prepare(db)) {
+            std::cerr << "Data source disabled: " << feed.source->name() << std::endl;
+            continue;
+        }
+        feed.sink = std::make_unique<UpdateSink>(queueCapacity_);
+        // Source and sink are heap objects, so they stay put if sources_ grows
+        DataSource* source = feed.source.get();
+        UpdateSink* sink = feed.sink.get();
+        feed.thread = std::thread([this, source, sink] {
+            source->run(*sink, stopping_);
+        });
+        ++started;
+    }
+    running_ = true;
+    return started;
+}
+
+void Ingestion::stop() {
+    if (!running_) return;
+    
+    stopping_.store(true);
+    for (auto& feed : sources_) {
+        if (feed.thread.joinable()) {
+            feed.thread.join();
+        }
+    }
+    running_ = false;
+}
+
+std::size_t Ingestion::drain(VariableDatabase& db, std::size_t maxUpdates) {
+    std::size_t appliedNow = 0;
+    db.beginBatch();
+    for (auto& feed : sources_) {
+        if (!feed.sink || appliedNow >= maxUpdates) continue;
+        appliedNow += feed.sink->queue().drain([&db](DataUpdate&& update) {
+            db.setVariable(update.id, update.value, update.time);
+        }, maxUpdates - appliedNow);
+    }
+    db.commitBatch();
+    applied_ += appliedNow;
+    return appliedNow;
+}
+
+bool Ingestion::hasQueuedUpdates() const {
+    for (const auto& feed : sources_) {
+        if (feed.sink && feed.sink->queue().size() > 0) return true;
+    }
+    return false;
+}
+
+std::uint64_t Ingestion::droppedUpdates() const {
+    std::uint64_t dropped = 0;
+    for (const auto& feed : sources_) {
+        if (feed.sink) dropped += feed.sink->dropped();
+    }
+    return dropped;
+}
+
+} // namespace xsmall_hmi
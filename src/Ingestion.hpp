@@ -0,0 +1,96 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "SpscQueue.hpp"
+#include "VariableDatabase.hpp"
+
+namespace xsmall_hmi {
+
+struct DataUpdate {
+    VariableId id = InvalidVariableId;
+    VariableDatabase::ValueType value;
+    double time = 0.0;  // when the source produced it, see VariableDatabase::now()
+};
+
+// Producer end of one source's queue. A full queue drops the update rather
+// than blocking the source; drops are counted.
+class UpdateSink {
+public:
+    explicit UpdateSink(std::size_t capacity) : queue_(capacity) {}
+    
+    // Stamped with the time of the call unless the source knows better
+    bool push(VariableId id, VariableDatabase::ValueType value,
+              double time = VariableDatabase::now()) {
+        if (queue_.tryPush(DataUpdate{id, std::move(value), time})) return true;
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    
+    std::uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+    SpscQueue<DataUpdate>& queue() { return queue_; }
+    
+private:
+    SpscQueue<DataUpdate> queue_;
+    std::atomic<std::uint64_t> dropped_{0};
+};
+
+// A producer of variable updates running on its own thread
+class DataSource {
+public:
+    virtual ~DataSource() = default;
+    
+    virtual std::string name() const = 0;
+    // Runs on the UI thread before the source thread starts; resolves every
+    // variable the source will write. False disables the source.
+    virtual bool prepare(VariableDatabase& db) = 0;
+    // Source thread body; must return soon after stop becomes true
+    virtual void run(UpdateSink& sink, const std::atomic<bool>& stop) = 0;
+};
+
+// Runs data sources on background threads. Each source has its own SPSC
+// queue; drain() empties all of them into the database once per frame as
+// a single batch, so subscribers see at most one change per variable.
+class Ingestion {
+public:
+    explicit Ingestion(std::size_t queueCapacity = 1 << 16);
+    ~Ingestion();
+    Ingestion(const Ingestion&) = delete;
+    Ingestion& operator=(const Ingestion&) = delete;
+    
+    // Sources added while running start with the next start()
+    void addSource(std::unique_ptr<DataSource> source);
+    // Number of sources started
+    std::size_t start(VariableDatabase& db);
+    void stop();
+    bool isRunning() const { return running_; }
+    
+    // Owning thread only; applies at most maxUpdates queued updates
+    std::size_t drain(VariableDatabase& db, std::size_t maxUpdates = SIZE_MAX);
+    
+    // Owning thread only: whether drain() has updates to apply
+    bool hasQueuedUpdates() const;
+    
+    std::size_t sourceCount() const { return sources_.size(); }
+    std::uint64_t droppedUpdates() const;
+    std::uint64_t appliedUpdates() const { return applied_; }
+    
+private:
+    struct Feed {
+        std::unique_ptr<DataSource> source;
+        std::unique_ptr<UpdateSink> sink;
+        std::thread thread;
+    };
+    
+    std::size_t queueCapacity_;
+    std::vector<Feed> sources_;
+    std::atomic<bool> stopping_{false};
+    bool running_ = false;
+    std::uint64_t applied_ = 0;
+};
+
+} // namespace xsmall_hmi
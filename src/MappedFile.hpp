@@ -0,0 +1,35 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace xsmall_hmi {
+
+// Read-only memory mapping of a whole file. Pages are loaded on demand by
+// the OS, so opening is cheap regardless of file size.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    
+    bool open(const std::string& path);
+    void close();
+    
+    bool isOpen() const { return data_ != nullptr; }
+    const std::uint8_t* data() const { return data_; }
+    std::size_t size() const { return size_; }
+    
+private:
+    const std::uint8_t* data_ = nullptr;
+    std::size_t size_ = 0;
+#ifdef _WIN32
+    void* file_ = nullptr;
+    void* mapping_ = nullptr;
+#endif
+};
+
+} // namespace xsmall_hmi
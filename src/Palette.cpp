@@ -1,9 +1,11 @@
 #include "Palette.hpp"
+#include "ResourceCache.hpp"
 #include <SFML/Graphics.hpp>
 
 namespace xsmall_hmi {
 
-Palette::Palette() {
+Palette::Palette()
+    : font_(ResourceCache::instance().getFont("arial.ttf")) {
     paletteBackground_.setSize(sf::Vector2f(200, 600));
     paletteBackground_.setFillColor(sf::Color(240, 240, 240));
     paletteBackground_.setOutlineColor(sf::Color(180, 180, 180));
@@ -29,43 +31,40 @@ Palette::Palette() {
     }
 }
 
-void Palette::draw(sf::RenderWindow& window) {
-    window.draw(paletteBackground_);
+void Palette::draw(sf::RenderTarget& target) {
+    target.draw(paletteBackground_);
     
-    sf::Font font;
-    if (font.openFromFile("arial.ttf")) {
-        sf::Text toolText(font, "", 16);
-        toolText.setFillColor(sf::Color::Black);
+    sf::Text toolText(*font_, "", 16);
+    toolText.setFillColor(sf::Color::Black);
+    
+    for (const auto& [rect, tool] : toolButtons_) {
+        sf::RectangleShape button;
+        button.setPosition(rect.position);
+        button.setSize(rect.size);
+        
+        bool isCurrent = (tool == currentTool_);
+        button.setFillColor(isCurrent ? sf::Color(200, 220, 255) : sf::Color(220, 220, 220));
+        button.setOutlineColor(sf::Color(150, 150, 150));
+        button.setOutlineThickness(1.0f);
         
-        for (const auto& [rect, tool] : toolButtons_) {
-            sf::RectangleShape button;
-            button.setPosition(rect.position);
-            button.setSize(rect.size);
-            
-            bool isCurrent = (tool == currentTool_);
-            button.setFillColor(isCurrent ? sf::Color(200, 220, 255) : sf::Color(220, 220, 220));
-            button.setOutlineColor(sf::Color(150, 150, 150));
-            button.setOutlineThickness(1.0f);
-            
-            window.draw(button);
-            
-            std::string name;
-            switch (tool) {
-                case Tool::Select: name = "Select"; break;
-                case Tool::Rectangle: name = "Rectangle"; break;
-                case Tool::Line: name = "Line"; break;
-                case Tool::Polyline: name = "Polyline"; break;
-                case Tool::Text: name = "Text"; break;
-                case Tool::Button: name = "Button"; break;
-                case Tool::InputField: name = "Input Field"; break;
-                case Tool::HistoryGraph: name = "History Graph"; break;
-                case Tool::Image: name = "Image"; break;
-            }
-            
-            toolText.setString(name);
-            toolText.setPosition(rect.position + sf::Vector2f(10, 10));
-            window.draw(toolText);
+        target.draw(button);
+        
+        std::string name;
+        switch (tool) {
+            case Tool::Select: name = "Select"; break;
+            case Tool::Rectangle: name = "Rectangle"; break;
+            case Tool::Line: name = "Line"; break;
+            case Tool::Polyline: name = "Polyline"; break;
+            case Tool::Text: name = "Text"; break;
+            case Tool::Button: name = "Button"; break;
+            case Tool::InputField: name = "Input Field"; break;
+            case Tool::HistoryGraph: name = "History Graph"; break;
+            case Tool::Image: name = "Image"; break;
         }
+        
+        toolText.setString(name);
+        toolText.setPosition(rect.position + sf::Vector2f(10, 10));
+        target.draw(toolText);
     }
 }
 
@@ -2,6 +2,7 @@
 #include <SFML/Graphics.hpp>
 #include <vector>
 #include <string>
+#include <memory>
 
 namespace xsmall_hmi {
 
@@ -21,7 +22,7 @@ public:
     
     Palette();
     
-    void draw(sf::RenderWindow& window);
+    void draw(sf::RenderTarget& target);
     Tool handleClick(const sf::Vector2f& mousePos);
     Tool getCurrentTool() const { return currentTool_; }
     
@@ -29,6 +30,7 @@ private:
     Tool currentTool_ = Tool::Select;
     sf::RectangleShape paletteBackground_;
     std::vector<std::pair<sf::FloatRect, Tool>> toolButtons_;
+    std::shared_ptr<const sf::Font> font_;
 };
 
 } // namespace xsmall_hmi
\ No newline at end of file
@@ -0,0 +1,222 @@
+#include "Profiler.hpp"
+#include "ResourceCache.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+namespace xsmall_hmi {
+
+namespace {
+
+const char* const PhaseNames[] = {"events", "dispatch", "update", "render", "present"};
+const char* const CounterNames[] = {"callbacks", "objects updated", "draw calls"};
+const char* const ObjectTypeNames[] = {
+    "Rectangle", "Line", "Polyline", "Text", "Button", "InputField", "HistoryGraph", "Image"
+};
+const char* const UpdateTraceNames[] = {
+    "update Rectangle", "update Line", "update Polyline", "update Text",
+    "update Button", "update InputField", "update HistoryGraph", "update Image"
+};
+const char* const DrawTraceNames[] = {
+    "draw Rectangle", "draw Line", "draw Polyline", "draw Text",
+    "draw Button", "draw InputField", "draw HistoryGraph", "draw Image"
+};
+
+double toMilliseconds(Profiler::Clock::duration duration) {
+    return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+} // namespace
+
+Profiler& Profiler::instance() {
+    static Profiler profiler;
+    return profiler;
+}
+
+void Profiler::setEnabled(bool enabled) {
+    if (enabled == enabled_) return;
+    
+    enabled_ = enabled;
+    if (enabled_) {
+        // Each session starts a fresh trace
+        origin_ = Clock::now();
+        trace_.clear();
+        frameHistory_.fill(0.0f);
+        historyPosition_ = 0;
+        last_ = FrameTotals();
+    }
+    inFrame_ = false;
+}
+
+void Profiler::beginFrame() {
+    if (!enabled_) return;
+    
+    frameStart_ = Clock::now();
+    inFrame_ = true;
+    phaseMs_.fill(0.0);
+    counters_.fill(0);
+    updateMs_.fill(0.0);
+    drawMs_.fill(0.0);
+}
+
+void Profiler::endFrame() {
+    if (!enabled_ || !inFrame_) return;
+    
+    Clock::time_point end = Clock::now();
+    inFrame_ = false;
+    
+    last_.phaseMs = phaseMs_;
+    last_.counters = counters_;
+    last_.updateMs = updateMs_;
+    last_.drawMs = drawMs_;
+    last_.frameMs = toMilliseconds(end - frameStart_);
+    
+    frameHistory_[historyPosition_] = static_cast<float>(last_.frameMs);
+    historyPosition_ = (historyPosition_ + 1) % HistogramSize;
+    
+    // Per-frame totals become counter tracks next to the phase spans
+    double timestamp = sinceOrigin(end);
+    addTrace("frame ms", 'C', timestamp, last_.frameMs);
+    for (std::size_t i = 0; i < CounterCount; ++i) {
+        addTrace(CounterNames[i], 'C', timestamp, static_cast<double>(last_.counters[i]));
+    }
+    for (std::size_t i = 0; i < ObjectTypeCount; ++i) {
+        if (last_.updateMs[i] > 0.0) addTrace(UpdateTraceNames[i], 'C', timestamp, last_.updateMs[i]);
+        if (last_.drawMs[i] > 0.0) addTrace(DrawTraceNames[i], 'C', timestamp, last_.drawMs[i]);
+    }
+}
+
+void Profiler::addPhase(Phase phase, Clock::time_point start, Clock::time_point end) {
+    std::size_t index = static_cast<std::size_t>(phase);
+    phaseMs_[index] += toMilliseconds(end - start);
+    addTrace(PhaseNames[index], 'X', sinceOrigin(start),
+             std::chrono::duration<double, std::micro>(end - start).count());
+}
+
+void Profiler::addObjectTime(ObjectType type, ObjectWork work, Clock::duration duration) {
+    auto& totals = work == ObjectWork::Update ? updateMs_ : drawMs_;
+    totals[static_cast<std::size_t>(type)] += toMilliseconds(duration);
+}
+
+void Profiler::addObjectTimes(ObjectWork work, const ObjectTimes& times) {
+    for (std::size_t type = 0; type < ObjectTypeCount; ++type) {
+        if (times[type] != Clock::duration::zero()) {
+            addObjectTime(static_cast<ObjectType>(type), work, times[type]);
+        }
+    }
+}
+
+void Profiler::addTrace(const char* name, char type, double timestamp, double value) {
+    // Bounded so a long session cannot grow without limit
+    if (trace_.size() < MaxTraceEvents) {
+        trace_.push_back({name, type, timestamp, value});
+    }
+}
+
+double Profiler::sinceOrigin(Clock::time_point time) const {
+    return std::chrono::duration<double, std::micro>(time - origin_).count();
+}
+
+void Profiler::drawOverlay(sf::RenderTarget& target) {
+    if (!font_) {
+        font_ = ResourceCache::instance().getFont("arial.ttf");
+    }
+    
+    const sf::Vector2f origin(target.getSize().x - 330.0f, 10.0f);
+    const sf::Vector2f size(320.0f, 330.0f);
+    
+    sf::RectangleShape background(size);
+    background.setPosition(origin);
+    background.setFillColor(sf::Color(20, 20, 20, 200));
+    target.draw(background);
+    
+    char line[96];
+    overlayString_.clear();
+    std::snprintf(line, sizeof(line), "frame %.2f ms\n", last_.frameMs);
+    overlayString_ += line;
+    for (std::size_t i = 0; i < PhaseCount; ++i) {
+        std::snprintf(line, sizeof(line), "  %-9s %.3f ms\n", PhaseNames[i], last_.phaseMs[i]);
+        overlayString_ += line;
+    }
+    for (std::size_t i = 0; i < CounterCount; ++i) {
+        std::snprintf(line, sizeof(line), "%s: %llu\n", CounterNames[i],
+                      static_cast<unsigned long long>(last_.counters[i]));
+        overlayString_ += line;
+    }
+    for (std::size_t i = 0; i < ObjectTypeCount; ++i) {
+        if (last_.updateMs[i] == 0.0 && last_.drawMs[i] == 0.0) continue;
+        std::snprintf(line, sizeof(line), "  %-12s upd %.3f  draw %.3f\n", ObjectTypeNames[i],
+                      last_.updateMs[i], last_.drawMs[i]);
+        overlayString_ += line;
+    }
+    
+    if (!overlayText_) {
+        overlayText_.emplace(*font_, "", 12);
+        overlayText_->setFillColor(sf::Color(230, 230, 230));
+    }
+    overlayText_->setString(overlayString_);
+    overlayText_->setPosition(origin + sf::Vector2f(8.0f, 4.0f));
+    target.draw(*overlayText_);
+    
+    // Rolling frame-time histogram, oldest frame on the left, 33 ms full scale
+    const float graphHeight = 60.0f;
+    const float barWidth = (size.x - 16.0f) / HistogramSize;
+    const sf::Vector2f graphOrigin(origin.x + 8.0f, origin.y + size.y - 8.0f);
+    const sf::Color budgetColor(90, 200, 90);
+    const sf::Color overBudgetColor(230, 80, 60);
+    
+    std::vector<sf::Vertex> bars;
+    bars.reserve(HistogramSize * 6);
+    for (std::size_t i = 0; i < HistogramSize; ++i) {
+        float frameMs = frameHistory_[(historyPosition_ + i) % HistogramSize];
+        float height = std::min(frameMs / 33.3f, 1.0f) * graphHeight;
+        if (height <= 0.0f) continue;
+        
+        sf::Color color = frameMs > 16.7f ? overBudgetColor : budgetColor;
+        float left = graphOrigin.x + i * barWidth;
+        float right = left + barWidth;
+        float top = graphOrigin.y - height;
+        bars.push_back(sf::Vertex{sf::Vector2f(left, top), color});
+        bars.push_back(sf::Vertex{sf::Vector2f(right, top), color});
+        bars.push_back(sf::Vertex{sf::Vector2f(right, graphOrigin.y), color});
+        bars.push_back(sf::Vertex{sf::Vector2f(left, top), color});
+        bars.push_back(sf::Vertex{sf::Vector2f(right, graphOrigin.y), color});
+        bars.push_back(sf::Vertex{sf::Vector2f(left, graphOrigin.y), color});
+    }
+    if (!bars.empty()) {
+        target.draw(bars.data(), bars.size(), sf::PrimitiveType::Triangles);
+    }
+    
+    // 60 FPS budget line
+    const float budgetY = graphOrigin.y - 16.7f / 33.3f * graphHeight;
+    sf::Vertex budget[] = {
+        sf::Vertex{sf::Vector2f(graphOrigin.x, budgetY), sf::Color(200, 200, 200)},
+        sf::Vertex{sf::Vector2f(origin.x + size.x - 8.0f, budgetY), sf::Color(200, 200, 200)}
+    };
+    target.draw(budget, 2, sf::PrimitiveType::Lines);
+}
+
+bool Profiler::writeChromeTrace(const std::string& filename) const {
+    std::ofstream file(filename, std::ios::trunc);
+    if (!file) return false;
+    
+    file << "{\"traceEvents\":[\n";
+    char line[160];
+    for (std::size_t i = 0; i < trace_.size(); ++i) {
+        const TraceEvent& event = trace_[i];
+        if (event.type == 'X') {
+            std::snprintf(line, sizeof(line),
+                          "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f}",
+                          event.name, event.timestamp, event.value);
+        } else {
+            std::snprintf(line, sizeof(line),
+                          "{\"name\":\"%s\",\"ph\":\"C\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"args\":{\"value\":%.4f}}",
+                          event.name, event.timestamp, event.value);
+        }
+        file << line << (i + 1 < trace_.size() ? ",\n" : "\n");
+    }
+    file << "],\"displayTimeUnit\":\"ms\"}\n";
+    return static_cast<bool>(file);
+}
+
+} // namespace xsmall_hmi
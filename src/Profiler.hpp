@@ -0,0 +1,145 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <array>
+#include <chrono>
+#include <memory>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+#include "ProfilerCounters.hpp"
+#include "VisualObject.hpp"
+
+namespace xsmall_hmi {
+
+// Per-frame instrumentation of the editor loop: phase timers, per object
+// type update/draw times and counters. Shown as a toggleable overlay with a
+// rolling frame-time histogram, and dumpable as a Chrome trace
+// (chrome://tracing, Perfetto). When disabled every probe is a single
+// branch on a static flag.
+class Profiler : public ProfilerCounters {
+public:
+    using Clock = std::chrono::steady_clock;
+    
+    enum class Phase {
+        Events,
+        Dispatch,
+        Update,
+        Render,
+        Present,
+        Count
+    };
+    
+    enum class ObjectWork {
+        Update,
+        Draw
+    };
+    
+    class Scope {
+    public:
+        explicit Scope(Phase phase)
+            : phase_(phase), active_(enabled_) {
+            if (active_) start_ = Clock::now();
+        }
+        ~Scope() {
+            if (active_) instance().addPhase(phase_, start_, Clock::now());
+        }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    
+    private:
+        Phase phase_;
+        bool active_;
+        Clock::time_point start_;
+    };
+    
+    class ObjectScope {
+    public:
+        ObjectScope(ObjectType type, ObjectWork work)
+            : type_(type), work_(work), active_(enabled_) {
+            if (active_) start_ = Clock::now();
+        }
+        ~ObjectScope() {
+            if (active_) instance().addObjectTime(type_, work_, Clock::now() - start_);
+        }
+        ObjectScope(const ObjectScope&) = delete;
+        ObjectScope& operator=(const ObjectScope&) = delete;
+    
+    private:
+        ObjectType type_;
+        ObjectWork work_;
+        bool active_;
+        Clock::time_point start_;
+    };
+    
+    // Per-type totals collected off the UI thread (one set per parallel
+    // chunk) and merged with addObjectTimes() afterwards
+    static constexpr std::size_t ObjectTypeCount = static_cast<std::size_t>(ObjectType::Image) + 1;
+    using ObjectTimes = std::array<Clock::duration, ObjectTypeCount>;
+    
+    static Profiler& instance();
+    
+    void setEnabled(bool enabled);
+    void toggle() { setEnabled(!enabled_); }
+    
+    // UI thread only, like every other non-static member
+    void addObjectTimes(ObjectWork work, const ObjectTimes& times);
+    
+    void beginFrame();
+    void endFrame();
+    
+    // Totals of the last completed frame
+    double lastFrameMs() const { return last_.frameMs; }
+    double lastPhaseMs(Phase phase) const { return last_.phaseMs[static_cast<std::size_t>(phase)]; }
+    std::uint64_t lastCount(Counter counter) const { return last_.counters[static_cast<std::size_t>(counter)]; }
+    
+    void drawOverlay(sf::RenderTarget& target);
+    bool writeChromeTrace(const std::string& filename) const;
+    
+private:
+    static constexpr std::size_t PhaseCount = static_cast<std::size_t>(Phase::Count);
+    static constexpr std::size_t HistogramSize = 240;
+    static constexpr std::size_t MaxTraceEvents = 1000000;
+    
+    struct TraceEvent {
+        const char* name;
+        char type;          // 'X' complete span, 'C' counter
+        double timestamp;   // microseconds since the profiler was enabled
+        double value;       // duration for spans, sample for counters
+    };
+    
+    struct FrameTotals {
+        std::array<double, PhaseCount> phaseMs{};
+        std::array<std::uint64_t, CounterCount> counters{};
+        std::array<double, ObjectTypeCount> updateMs{};
+        std::array<double, ObjectTypeCount> drawMs{};
+        double frameMs = 0.0;
+    };
+    
+    Profiler() = default;
+    
+    void addPhase(Phase phase, Clock::time_point start, Clock::time_point end);
+    void addObjectTime(ObjectType type, ObjectWork work, Clock::duration duration);
+    void addTrace(const char* name, char type, double timestamp, double value);
+    double sinceOrigin(Clock::time_point time) const;
+    
+    Clock::time_point origin_;
+    Clock::time_point frameStart_;
+    bool inFrame_ = false;
+    
+    std::array<double, PhaseCount> phaseMs_{};
+    std::array<double, ObjectTypeCount> updateMs_{};
+    std::array<double, ObjectTypeCount> drawMs_{};
+    FrameTotals last_;
+    
+    std::array<float, HistogramSize> frameHistory_{};
+    std::size_t historyPosition_ = 0;
+    
+    std::vector<TraceEvent> trace_;
+    
+    std::shared_ptr<const sf::Font> font_;
+    std::optional<sf::Text> overlayText_;
+    std::string overlayString_;
+};
+
+} // namespace xsmall_hmi
@@ -0,0 +1,33 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace xsmall_hmi {
+
+// The counting half of Profiler, without SFML or the scene types, so core
+// modules such as the variable database can count work on their own.
+// While the profiler is disabled count() is a single branch on a static flag.
+class ProfilerCounters {
+public:
+    enum class Counter {
+        CallbacksFired,
+        ObjectsUpdated,
+        DrawCalls,
+        Count
+    };
+    
+    static bool enabled() { return enabled_; }
+    static void count(Counter counter, std::uint64_t amount = 1) {
+        if (enabled_) counters_[static_cast<std::size_t>(counter)] += amount;
+    }
+    
+protected:
+    static constexpr std::size_t CounterCount = static_cast<std::size_t>(Counter::Count);
+    
+    // Set and reset by Profiler, on the UI thread
+    inline static bool enabled_ = false;
+    inline static std::array<std::uint64_t, CounterCount> counters_{};
+};
+
+} // namespace xsmall_hmi
@@ -0,0 +1,86 @@
+#include "ResourceCache.hpp"
+#include <iostream>
+
+namespace xsmall_hmi {
+
+ResourceCache& ResourceCache::instance() {
+    static ResourceCache cache;
+    return cache;
+}
+
+std::shared_ptr<const sf::Font> ResourceCache::getFont(const std::string& filename) {
+    auto& entry = fonts_[filename];
+    if (auto font = entry.lock()) {
+        return font;
+    }
+    
+    auto font = std::make_shared<sf::Font>();
+    if (!font->openFromFile(filename)) {
+        std::cerr << "Failed to open font: " << filename << std::endl;
+    }
+    entry = font;
+    return font;
+}
+
+std::shared_ptr<const AtlasImage> ResourceCache::getImage(const std::string& filename) {
+    auto& entry = images_[filename];
+    if (entry) {
+        return entry;
+    }
+    
+    entry = std::make_shared<AtlasImage>();
+    ++pendingImages_;
+    // Decoding touches no GL state, so it can run on any thread
+    decoders_.submit([this, filename, target = entry] {
+        DecodedImage decoded;
+        decoded.target = target;
+        decoded.ok = decoded.image.loadFromFile(filename);
+        if (!decoded.ok) {
+            std::cerr << "Failed to load image: " << filename << std::endl;
+        }
+        
+        std::lock_guard<std::mutex> lock(decodedMutex_);
+        decoded_.push_back(std::move(decoded));
+    });
+    return entry;
+}
+
+std::size_t ResourceCache::processLoadedImages() {
+    if (pendingImages_ == 0) return 0;
+    
+    {
+        std::lock_guard<std::mutex> lock(decodedMutex_);
+        uploading_.swap(decoded_);
+    }
+    
+    for (auto& decoded : uploading_) {
+        AtlasImage& image = *decoded.target;
+        std::optional<TextureAtlas::Region> region;
+        if (decoded.ok) {
+            region = atlas_.add(decoded.image);
+        }
+        
+        if (region) {
+            image.texture = region->texture;
+            image.rect = region->rect;
+            image.state = AtlasImage::State::Ready;
+        } else {
+            image.state = AtlasImage::State::Failed;
+        }
+    }
+    
+    std::size_t processed = uploading_.size();
+    pendingImages_ -= processed;
+    uploading_.clear();
+    return processed;
+}
+
+std::size_t ResourceCache::fontCount() const {
+    std::size_t alive = 0;
+    for (const auto& [name, entry] : fonts_) {
+        if (!entry.expired()) ++alive;
+    }
+    return alive;
+}
+
+} // namespace xsmall_hmi
@@ -0,0 +1,70 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "TextureAtlas.hpp"
+#include "ThreadPool.hpp"
+
+namespace xsmall_hmi {
+
+// Image placed in the shared atlas. Written only on the UI thread.
+struct AtlasImage {
+    enum class State {
+        Loading,
+        Ready,
+        Failed
+    };
+    
+    State state = State::Loading;
+    const sf::Texture* texture = nullptr;   // atlas page
+    sf::IntRect rect;                        // pixels within the page
+};
+
+// Loads each font or image file once and shares it between objects. Fonts
+// are only weakly referenced, so a font is released as soon as the last
+// object using it is destroyed.
+//
+// Images are decoded on a worker pool and packed into a shared texture
+// atlas. They stay cached for the life of the process, as atlas space is
+// not reclaimed.
+class ResourceCache {
+public:
+    static ResourceCache& instance();
+    
+    // Never null; a font that failed to open renders no glyphs
+    std::shared_ptr<const sf::Font> getFont(const std::string& filename);
+    // Returns at once; the image is usable when its state becomes Ready
+    std::shared_ptr<const AtlasImage> getImage(const std::string& filename);
+    // Uploads images decoded since the last call into the atlas. Call once
+    // per frame on the thread owning the GL context.
+    std::size_t processLoadedImages();
+    
+    std::size_t fontCount() const;
+    std::size_t imageCount() const { return images_.size(); }
+    std::size_t pendingImageCount() const { return pendingImages_; }
+    
+private:
+    ResourceCache() = default;
+    
+    struct DecodedImage {
+        std::shared_ptr<AtlasImage> target;
+        sf::Image image;
+        bool ok = false;
+    };
+    
+    std::unordered_map<std::string, std::weak_ptr<const sf::Font>> fonts_;
+    std::unordered_map<std::string, std::shared_ptr<AtlasImage>> images_;
+    std::size_t pendingImages_ = 0;
+    TextureAtlas atlas_;
+    
+    std::mutex decodedMutex_;
+    std::vector<DecodedImage> decoded_;
+    std::vector<DecodedImage> uploading_;
+    // Declared last so workers are joined before the state they write
+    ThreadPool decoders_;
+};
+
+} // namespace xsmall_hmi
@@ -0,0 +1,271 @@
+#include "SceneFile.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <unordered_map>
+
+namespace xsmall_hmi {
+
+namespace {
+
+const char FileMagic[4] = {'X', 'H', 'S', 'C'};
+const std::uint32_t FileVersion = 3;
+// Same layout, but expression bindings had no '=' marker yet
+const std::uint32_t UnmarkedBindingsVersion = 2;
+
+struct FileHeader {
+    char magic[4];
+    std::uint32_t version;
+    std::uint32_t objectCount;
+    std::uint32_t pointCount;
+    std::uint32_t stringCount;
+    std::uint32_t stringDataSize;
+    std::uint64_t objectsOffset;
+    std::uint64_t pointsOffset;
+    std::uint64_t stringOffsetsOffset;
+    std::uint64_t stringDataOffset;
+};
+
+static_assert(sizeof(FileHeader) == 56, "scene header layout");
+static_assert(sizeof(SceneFile::ObjectRecord) == 56, "scene record layout");
+static_assert(sizeof(SceneFile::Point) == 8, "scene point layout");
+
+// Deduplicates strings; index 0 is always the empty string
+class StringTable {
+public:
+    StringTable() {
+        offsets_.push_back(0);
+        offsets_.push_back(0);
+        indices_.emplace(std::string(), 0);
+    }
+    
+    std::uint32_t add(const std::string& string) {
+        auto it = indices_.find(string);
+        if (it != indices_.end()) return it->second;
+        
+        std::uint32_t index = static_cast<std::uint32_t>(offsets_.size() - 1);
+        data_.insert(data_.end(), string.begin(), string.end());
+        offsets_.push_back(static_cast<std::uint32_t>(data_.size()));
+        indices_.emplace(string, index);
+        return index;
+    }
+    
+    const std::vector<std::uint32_t>& offsets() const { return offsets_; }
+    const std::vector<char>& data() const { return data_; }
+    std::size_t count() const { return offsets_.size() - 1; }
+    
+private:
+    std::vector<std::uint32_t> offsets_;
+    std::vector<char> data_;
+    std::unordered_map<std::string, std::uint32_t> indices_;
+};
+
+std::size_t alignTo8(std::size_t offset) {
+    return (offset + 7) & ~static_cast<std::size_t>(7);
+}
+
+} // namespace
+
+bool SceneFile::save(const std::string& path, const SceneStore& objects) {
+    std::vector<ObjectRecord> records;
+    std::vector<Point> points;
+    StringTable strings;
+    records.reserve(objects.size());
+    
+    for (const VisualObject* obj : objects) {
+        ObjectRecord record{};
+        record.type = static_cast<std::uint8_t>(obj->getType());
+        record.color = obj->getColor().toInteger();
+        record.x = obj->getPosition().x;
+        record.y = obj->getPosition().y;
+        record.width = obj->getSize().x;
+        record.height = obj->getSize().y;
+        record.id = strings.add(obj->getId());
+        record.text = strings.add(obj->getText());
+        record.binding = strings.add(obj->getVariableBinding());
+        record.precision = static_cast<std::int8_t>(std::clamp(obj->getFormat().precision, -1, 127));
+        record.prefix = strings.add(obj->getFormat().prefix);
+        record.suffix = strings.add(obj->getFormat().suffix);
+        record.firstPoint = static_cast<std::uint32_t>(points.size());
+        
+        if (auto* line = objectCast<LineObject>(obj)) {
+            points.push_back({line->getStartPoint().x, line->getStartPoint().y});
+            points.push_back({line->getEndPoint().x, line->getEndPoint().y});
+        } else if (auto* polyline = objectCast<PolylineObject>(obj)) {
+            for (const auto& point : polyline->getPoints()) {
+                points.push_back({point.x, point.y});
+            }
+        } else if (auto* image = objectCast<ImageObject>(obj)) {
+            record.image = strings.add(image->getImagePath());
+        }
+        
+        record.pointCount = static_cast<std::uint32_t>(points.size()) - record.firstPoint;
+        records.push_back(record);
+    }
+    
+    FileHeader header{};
+    std::memcpy(header.magic, FileMagic, sizeof(FileMagic));
+    header.version = FileVersion;
+    header.objectCount = static_cast<std::uint32_t>(records.size());
+    header.pointCount = static_cast<std::uint32_t>(points.size());
+    header.stringCount = static_cast<std::uint32_t>(strings.count());
+    header.stringDataSize = static_cast<std::uint32_t>(strings.data().size());
+    header.objectsOffset = sizeof(FileHeader);
+    header.pointsOffset = alignTo8(header.objectsOffset + records.size() * sizeof(ObjectRecord));
+    header.stringOffsetsOffset = alignTo8(header.pointsOffset + points.size() * sizeof(Point));
+    header.stringDataOffset = header.stringOffsetsOffset + strings.offsets().size() * sizeof(std::uint32_t);
+    
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) return false;
+    
+    auto writeAt = [&file](std::uint64_t offset, const void* data, std::size_t size) {
+        static const char padding[8] = {};
+        std::uint64_t position = static_cast<std::uint64_t>(file.tellp());
+        file.write(padding, static_cast<std::streamsize>(offset - position));
+        file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+    };
+    
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    writeAt(header.objectsOffset, records.data(), records.size() * sizeof(ObjectRecord));
+    writeAt(header.pointsOffset, points.data(), points.size() * sizeof(Point));
+    writeAt(header.stringOffsetsOffset, strings.offsets().data(),
+            strings.offsets().size() * sizeof(std::uint32_t));
+    writeAt(header.stringDataOffset, strings.data().data(), strings.data().size());
+    return static_cast<bool>(file);
+}
+
+bool SceneFile::open(const std::string& path) {
+    close();
+    if (!map_.open(path)) return false;
+    
+    const std::size_t size = map_.size();
+    FileHeader header;
+    if (size < sizeof(header)) {
+        close();
+        return false;
+    }
+    std::memcpy(&header, map_.data(), sizeof(header));
+    
+    auto fits = [size](std::uint64_t offset, std::uint64_t bytes) {
+        return offset <= size && bytes <= size - offset;
+    };
+    
+    bool valid = std::memcmp(header.magic, FileMagic, sizeof(FileMagic)) == 0 &&
+                 (header.version == FileVersion || header.version == UnmarkedBindingsVersion) &&
+                 header.objectsOffset % alignof(ObjectRecord) == 0 &&
+                 header.pointsOffset % alignof(Point) == 0 &&
+                 header.stringOffsetsOffset % alignof(std::uint32_t) == 0 &&
+                 fits(header.objectsOffset, std::uint64_t(header.objectCount) * sizeof(ObjectRecord)) &&
+                 fits(header.pointsOffset, std::uint64_t(header.pointCount) * sizeof(Point)) &&
+                 fits(header.stringOffsetsOffset, (std::uint64_t(header.stringCount) + 1) * sizeof(std::uint32_t)) &&
+                 fits(header.stringDataOffset, header.stringDataSize) &&
+                 header.stringCount > 0;
+    if (!valid) {
+        close();
+        return false;
+    }
+    
+    // The mapping is page aligned, so the arrays can be used in place
+    const std::uint8_t* base = map_.data();
+    objects_ = reinterpret_cast<const ObjectRecord*>(base + header.objectsOffset);
+    points_ = reinterpret_cast<const Point*>(base + header.pointsOffset);
+    stringOffsets_ = reinterpret_cast<const std::uint32_t*>(base + header.stringOffsetsOffset);
+    stringData_ = reinterpret_cast<const char*>(base + header.stringDataOffset);
+    objectCount_ = header.objectCount;
+    pointCount_ = header.pointCount;
+    stringCount_ = header.stringCount;
+    unmarkedBindings_ = header.version == UnmarkedBindingsVersion;
+    
+    // Validated once here so the accessors need no checks
+    for (std::size_t i = 0; i < stringCount_; ++i) {
+        if (stringOffsets_[i] > stringOffsets_[i + 1]) valid = false;
+    }
+    valid = valid && stringOffsets_[stringCount_] <= header.stringDataSize;
+    for (std::size_t i = 0; valid && i < objectCount_; ++i) {
+        const ObjectRecord& record = objects_[i];
+        valid = record.type <= static_cast<std::uint8_t>(ObjectType::Image) &&
+                record.id < stringCount_ && record.text < stringCount_ &&
+                record.binding < stringCount_ && record.image < stringCount_ &&
+                record.prefix < stringCount_ && record.suffix < stringCount_ &&
+                record.firstPoint <= pointCount_ && record.pointCount <= pointCount_ - record.firstPoint;
+    }
+    if (!valid) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void SceneFile::close() {
+    map_.close();
+    objects_ = nullptr;
+    points_ = nullptr;
+    stringOffsets_ = nullptr;
+    stringData_ = nullptr;
+    objectCount_ = 0;
+    pointCount_ = 0;
+    stringCount_ = 0;
+    unmarkedBindings_ = false;
+}
+
+std::string_view SceneFile::string(std::uint32_t index) const {
+    if (index >= stringCount_) return {};
+    return std::string_view(stringData_ + stringOffsets_[index],
+                            stringOffsets_[index + 1] - stringOffsets_[index]);
+}
+
+std::size_t SceneFile::load(VariableDatabase& db, SceneStore& out) const {
+    for (std::size_t i = 0; i < objectCount_; ++i) {
+        createObject(objects_[i], db, out);
+    }
+    return objectCount_;
+}
+
+VisualObject* SceneFile::createObject(const ObjectRecord& record, VariableDatabase& db, SceneStore& out) const {
+    std::string id(string(record.id));
+    VisualObject* object = nullptr;
+    
+    switch (static_cast<ObjectType>(record.type)) {
+        case ObjectType::Rectangle: object = out.create<RectangleObject>(id); break;
+        case ObjectType::Line: object = out.create<LineObject>(id); break;
+        case ObjectType::Polyline: object = out.create<PolylineObject>(id); break;
+        case ObjectType::Text: object = out.create<TextObject>(id); break;
+        case ObjectType::Button: object = out.create<ButtonObject>(id); break;
+        case ObjectType::InputField: object = out.create<InputFieldObject>(id); break;
+        case ObjectType::HistoryGraph: object = out.create<HistoryGraphObject>(id); break;
+        case ObjectType::Image: object = out.create<ImageObject>(id); break;
+    }
+    
+    object->setPosition(sf::Vector2f(record.x, record.y));
+    object->setSize(sf::Vector2f(record.width, record.height));
+    object->setColor(sf::Color(record.color));
+    object->setText(std::string(string(record.text)));
+    FormatSpec format;
+    format.precision = record.precision;
+    format.prefix = string(record.prefix);
+    format.suffix = string(record.suffix);
+    object->setFormat(format);
+    if (record.binding != 0) {
+        std::string binding(string(record.binding));
+        object->setVariableBinding(db, unmarkedBindings_ ? Expression::markLegacy(binding) : binding);
+    }
+    
+    const Point* recordPoints = points(record);
+    if (auto* line = objectCast<LineObject>(object)) {
+        if (record.pointCount == 2) {
+            line->setPoints(sf::Vector2f(recordPoints[0].x, recordPoints[0].y),
+                            sf::Vector2f(recordPoints[1].x, recordPoints[1].y));
+        }
+    } else if (auto* polyline = objectCast<PolylineObject>(object)) {
+        for (std::uint32_t i = 0; i < record.pointCount; ++i) {
+            polyline->addPoint(sf::Vector2f(recordPoints[i].x, recordPoints[i].y));
+        }
+    } else if (auto* image = objectCast<ImageObject>(object)) {
+        if (record.image != 0) {
+            image->loadFromFile(std::string(string(record.image)));
+        }
+    }
+    return object;
+}
+
+} // namespace xsmall_hmi
@@ -0,0 +1,73 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "MappedFile.hpp"
+#include "VariableDatabase.hpp"
+#include "SceneStore.hpp"
+#include "VisualObject.hpp"
+
+namespace xsmall_hmi {
+
+// Versioned binary scene file, read in place from a memory mapping.
+//
+// Layout: a fixed header followed by four arrays, each at an offset given in
+// the header: fixed-size object records, polyline/line points, string
+// offsets and string bytes. Ids, texts, bindings, format affixes and image
+// paths are indices into the string table (index 0 is the empty string), so
+// a record never points outside the file and nothing has to be parsed
+// before use.
+// Integers and floats are stored in host byte order.
+class SceneFile {
+public:
+    struct ObjectRecord {
+        std::uint8_t type;
+        std::int8_t precision;      // FormatSpec::precision
+        std::uint8_t reserved[2];
+        std::uint32_t color;        // sf::Color::toInteger()
+        float x, y, width, height;
+        std::uint32_t id;
+        std::uint32_t text;
+        std::uint32_t binding;
+        std::uint32_t image;
+        std::uint32_t firstPoint;
+        std::uint32_t pointCount;
+        std::uint32_t prefix;
+        std::uint32_t suffix;
+    };
+    
+    struct Point {
+        float x, y;
+    };
+    
+    static bool save(const std::string& path, const SceneStore& objects);
+    
+    bool open(const std::string& path);
+    void close();
+    bool isOpen() const { return objects_ != nullptr; }
+    
+    std::size_t objectCount() const { return objectCount_; }
+    const ObjectRecord& object(std::size_t index) const { return objects_[index]; }
+    const Point* points(const ObjectRecord& record) const { return points_ + record.firstPoint; }
+    std::string_view string(std::uint32_t index) const;
+    
+    // Creates the objects in file order; bindings are interned in db
+    std::size_t load(VariableDatabase& db, SceneStore& out) const;
+    VisualObject* createObject(const ObjectRecord& record, VariableDatabase& db, SceneStore& out) const;
+    
+private:
+    MappedFile map_;
+    const ObjectRecord* objects_ = nullptr;
+    const Point* points_ = nullptr;
+    const std::uint32_t* stringOffsets_ = nullptr;
+    const char* stringData_ = nullptr;
+    std::size_t objectCount_ = 0;
+    std::size_t pointCount_ = 0;
+    std::size_t stringCount_ = 0;
+    bool unmarkedBindings_ = false;
+};
+
+} // namespace xsmall_hmi
@@ -0,0 +1,339 @@
+#include "SceneRenderer.hpp"
+#include "Profiler.hpp"
+#include <algorithm>
+#include <unordered_map>
+
+namespace xsmall_hmi {
+
+namespace {
+
+sf::FloatRect unite(const sf::FloatRect& a, const sf::FloatRect& b) {
+    const sf::Vector2f topLeft(std::min(a.position.x, b.position.x), std::min(a.position.y, b.position.y));
+    const sf::Vector2f bottomRight(std::max(a.position.x + a.size.x, b.position.x + b.size.x),
+                                   std::max(a.position.y + a.size.y, b.position.y + b.size.y));
+    return sf::FloatRect(topLeft, bottomRight - topLeft);
+}
+
+} // namespace
+
+void SceneRenderer::DirtyRange::add(std::size_t offset, std::size_t count) {
+    if (count == 0) return;
+    first = std::min(first, offset);
+    last = std::max(last, offset + count);
+}
+
+void SceneRenderer::update(const SceneStore& objects) {
+    if (!buffersChecked_) {
+        // Needs an active GL context, so it is checked on first use
+        useVertexBuffers_ = sf::VertexBuffer::isAvailable();
+        buffersChecked_ = true;
+    }
+    
+    if (!layoutMatches(objects) || !refreshChanged(objects)) {
+        relayout(objects);
+    }
+    if (runsDirty_) {
+        rebuildRuns();
+    }
+    upload();
+}
+
+void SceneRenderer::draw(sf::RenderTarget& target, const sf::FloatRect& clip) {
+    batchDrawCalls_ = 0;
+    for (const Run& run : runs_) {
+        switch (run.kind) {
+            case Run::Kind::Triangles:
+                drawRun(target, triangleBuffer_, triangles_, run, sf::PrimitiveType::Triangles);
+                break;
+            case Run::Kind::Lines:
+                drawRun(target, lineBuffer_, lines_, run, sf::PrimitiveType::Lines);
+                break;
+            case Run::Kind::Textured:
+                target.draw(textured_.data() + run.first, run.count, sf::PrimitiveType::Triangles,
+                            sf::RenderStates(run.texture));
+                ++batchDrawCalls_;
+                Profiler::count(Profiler::Counter::DrawCalls);
+                break;
+            case Run::Kind::Overlay:
+                drawOverlays(target, run, clip);
+                break;
+        }
+    }
+}
+
+void SceneRenderer::drawOverlays(sf::RenderTarget& target, const Run& run, const sf::FloatRect& clip) const {
+    // Entries match the objects as of the last update()
+    for (std::size_t i = run.first; i < run.first + run.count; ++i) {
+        const Entry& entry = entries_[overlayOrder_[i]];
+        if (!entry.bounds.findIntersection(clip)) continue;
+        if (Profiler::enabled()) {
+            Profiler::ObjectScope scope(entry.object->getType(), Profiler::ObjectWork::Draw);
+            entry.object->drawOverlay(target);
+        } else {
+            entry.object->drawOverlay(target);
+        }
+    }
+}
+
+void SceneRenderer::draw(sf::RenderTarget& target) {
+    const sf::View& view = target.getView();
+    draw(target, sf::FloatRect(view.getCenter() - view.getSize() / 2.0f, view.getSize()));
+}
+
+void SceneRenderer::render(sf::RenderTarget& target, const SceneStore& objects) {
+    update(objects);
+    draw(target);
+    clearDamage();
+}
+
+void SceneRenderer::clearDamage() {
+    damage_.clear();
+    fullDamage_ = false;
+}
+
+void SceneRenderer::addDamage(const sf::FloatRect& rect) {
+    if (fullDamage_ || rect.size.x <= 0 || rect.size.y <= 0) return;
+    
+    // Overlapping areas are repainted once
+    for (auto& damage : damage_) {
+        if (damage.findIntersection(rect)) {
+            damage = unite(damage, rect);
+            return;
+        }
+    }
+    damage_.push_back(rect);
+    
+    if (damage_.size() > MaxDamageRects) {
+        sf::FloatRect all = damage_.front();
+        for (const auto& damage : damage_) {
+            all = unite(all, damage);
+        }
+        damage_.assign(1, all);
+    }
+}
+
+bool SceneRenderer::layoutMatches(const SceneStore& objects) const {
+    if (entries_.size() != objects.size()) return false;
+    
+    const auto& list = objects.objects();
+    for (std::size_t i = 0; i < list.size(); ++i) {
+        if (entries_[i].object != list[i]) return false;
+    }
+    return true;
+}
+
+bool SceneRenderer::refreshChanged(const SceneStore& objects) {
+    // Versions are packed in the store, so unchanged objects are never touched
+    const auto& versions = objects.geometryVersions();
+    for (std::size_t i = 0; i < entries_.size(); ++i) {
+        Entry& entry = entries_[i];
+        if (entry.version == versions[i]) continue;
+        
+        scratchTriangles_.clear();
+        scratchLines_.clear();
+        {
+            Profiler::ObjectScope scope(entry.object->getType(), Profiler::ObjectWork::Draw);
+            entry.object->appendGeometry(scratchTriangles_, scratchLines_);
+        }
+        
+        // A changed vertex count shifts every later object
+        if (scratchTriangles_.size() != entry.triangleCount ||
+            scratchLines_.size() != entry.lineCount) {
+            return false;
+        }
+        
+        // So does a part appearing or going away, as it changes the runs
+        scratchTextured_.clear();
+        bool textured = entry.object->appendTexturedGeometry(scratchTextured_) != nullptr;
+        if (textured != entry.textured || entry.object->hasOverlay() != entry.overlay) return false;
+        runsDirty_ = runsDirty_ || textured;
+        
+        std::copy(scratchTriangles_.begin(), scratchTriangles_.end(),
+                  triangles_.begin() + entry.triangleOffset);
+        std::copy(scratchLines_.begin(), scratchLines_.end(),
+                  lines_.begin() + entry.lineOffset);
+        dirtyTriangles_.add(entry.triangleOffset, entry.triangleCount);
+        dirtyLines_.add(entry.lineOffset, entry.lineCount);
+        entry.version = entry.object->getGeometryVersion();
+        
+        addDamage(entry.bounds);
+        entry.bounds = entry.object->getDrawBounds();
+        addDamage(entry.bounds);
+    }
+    return true;
+}
+
+void SceneRenderer::relayout(const SceneStore& objects) {
+    // Unchanged objects are copied from the previous batches, not re-tessellated
+    std::unordered_map<const VisualObject*, std::size_t> previous;
+    previous.reserve(entries_.size());
+    for (std::size_t i = 0; i < entries_.size(); ++i) {
+        previous.emplace(entries_[i].object, i);
+    }
+    
+    std::vector<Entry> entries;
+    std::vector<sf::Vertex> triangles;
+    std::vector<sf::Vertex> lines;
+    entries.reserve(objects.size());
+    triangles.reserve(triangles_.size());
+    lines.reserve(lines_.size());
+    
+    // Highest previous index kept so far; a kept object below it changed
+    // stacking order with something drawn over it
+    std::size_t keptOrder = 0;
+    for (const VisualObject* obj : objects) {
+        Entry entry;
+        entry.object = obj;
+        entry.version = obj->getGeometryVersion();
+        entry.triangleOffset = triangles.size();
+        entry.lineOffset = lines.size();
+        
+        auto it = previous.find(obj);
+        const Entry* old = it != previous.end() ? &entries_[it->second] : nullptr;
+        if (old && old->version == entry.version) {
+            triangles.insert(triangles.end(), triangles_.begin() + old->triangleOffset,
+                             triangles_.begin() + old->triangleOffset + old->triangleCount);
+            lines.insert(lines.end(), lines_.begin() + old->lineOffset,
+                         lines_.begin() + old->lineOffset + old->lineCount);
+            entry.textured = old->textured;
+            entry.overlay = old->overlay;
+            entry.bounds = old->bounds;
+            if (it->second < keptOrder) addDamage(entry.bounds);
+            keptOrder = std::max(keptOrder, it->second);
+        } else {
+            {
+                Profiler::ObjectScope scope(obj->getType(), Profiler::ObjectWork::Draw);
+                obj->appendGeometry(triangles, lines);
+                scratchTextured_.clear();
+                entry.textured = obj->appendTexturedGeometry(scratchTextured_) != nullptr;
+                entry.overlay = obj->hasOverlay();
+            }
+            entry.bounds = obj->getDrawBounds();
+            addDamage(entry.bounds);
+            if (old) addDamage(old->bounds);
+        }
+        if (old) previous.erase(it);
+        
+        entry.triangleCount = triangles.size() - entry.triangleOffset;
+        entry.lineCount = lines.size() - entry.lineOffset;
+        entries.push_back(entry);
+    }
+    
+    // Objects that are gone leave their area behind
+    for (const auto& [object, index] : previous) {
+        addDamage(entries_[index].bounds);
+    }
+    
+    entries_ = std::move(entries);
+    triangles_ = std::move(triangles);
+    lines_ = std::move(lines);
+    fullUpload_ = true;
+    runsDirty_ = true;
+}
+
+void SceneRenderer::rebuildRuns() {
+    // A part continues the previous run only if it is of the same kind and
+    // follows it directly, so nothing is drawn out of stacking order.
+    // Overlays (text) would split the geometry runs after every labelled
+    // object, so they wait until geometry that overlaps one of them comes
+    // up; overlays over disjoint objects then cost no geometry run breaks.
+    runs_.clear();
+    textured_.clear();
+    overlayOrder_.clear();
+    auto extend = [this](Run::Kind kind, std::size_t first, std::size_t count, const sf::Texture* texture) {
+        if (count == 0) return;
+        if (!runs_.empty()) {
+            Run& last = runs_.back();
+            if (last.kind == kind && last.texture == texture && last.first + last.count == first) {
+                last.count += count;
+                return;
+            }
+        }
+        runs_.push_back(Run{kind, first, count, texture});
+    };
+    
+    std::size_t pendingFirst = 0;
+    sf::FloatRect pendingArea;
+    auto flushOverlays = [&]() {
+        if (overlayOrder_.size() > pendingFirst) {
+            runs_.push_back(Run{Run::Kind::Overlay, pendingFirst, overlayOrder_.size() - pendingFirst, nullptr});
+            pendingFirst = overlayOrder_.size();
+        }
+    };
+    auto overlapsPending = [&](const sf::FloatRect& bounds) {
+        if (overlayOrder_.size() == pendingFirst || !pendingArea.findIntersection(bounds)) return false;
+        for (std::size_t k = pendingFirst; k < overlayOrder_.size(); ++k) {
+            if (entries_[overlayOrder_[k]].bounds.findIntersection(bounds)) return true;
+        }
+        return false;
+    };
+    
+    // Same order as VisualObject::draw()
+    for (std::size_t i = 0; i < entries_.size(); ++i) {
+        const Entry& entry = entries_[i];
+        const bool geometry = entry.triangleCount > 0 || entry.lineCount > 0 || entry.textured;
+        if (geometry && overlapsPending(entry.bounds)) {
+            flushOverlays();
+        }
+        extend(Run::Kind::Triangles, entry.triangleOffset, entry.triangleCount, nullptr);
+        extend(Run::Kind::Lines, entry.lineOffset, entry.lineCount, nullptr);
+        if (entry.textured) {
+            const std::size_t first = textured_.size();
+            const sf::Texture* texture = entry.object->appendTexturedGeometry(textured_);
+            extend(Run::Kind::Textured, first, textured_.size() - first, texture);
+        }
+        if (entry.overlay) {
+            pendingArea = overlayOrder_.size() == pendingFirst ? entry.bounds : unite(pendingArea, entry.bounds);
+            overlayOrder_.push_back(i);
+        }
+    }
+    flushOverlays();
+    runsDirty_ = false;
+}
+
+void SceneRenderer::upload() {
+    if (!useVertexBuffers_) {
+        dirtyTriangles_ = DirtyRange();
+        dirtyLines_ = DirtyRange();
+        return;
+    }
+    
+    auto uploadBatch = [this](sf::VertexBuffer& buffer, const std::vector<sf::Vertex>& vertices,
+                              DirtyRange& dirty) {
+        bool ok = true;
+        if (fullUpload_ || buffer.getVertexCount() != vertices.size()) {
+            if (buffer.getVertexCount() != vertices.size()) {
+                ok = buffer.create(vertices.size());
+            }
+            if (ok && !vertices.empty()) {
+                ok = buffer.update(vertices.data(), vertices.size(), 0);
+            }
+        } else if (!dirty.empty()) {
+            ok = buffer.update(vertices.data() + dirty.first, dirty.last - dirty.first,
+                               static_cast<unsigned>(dirty.first));
+        }
+        dirty = DirtyRange();
+        return ok;
+    };
+    
+    bool trianglesOk = uploadBatch(triangleBuffer_, triangles_, dirtyTriangles_);
+    bool linesOk = uploadBatch(lineBuffer_, lines_, dirtyLines_);
+    if (!trianglesOk || !linesOk) {
+        // Fall back to drawing straight from client memory
+        useVertexBuffers_ = false;
+    }
+    fullUpload_ = false;
+}
+
+void SceneRenderer::drawRun(sf::RenderTarget& target, sf::VertexBuffer& buffer,
+                            const std::vector<sf::Vertex>& vertices, const Run& run, sf::PrimitiveType type) {
+    if (useVertexBuffers_) {
+        target.draw(buffer, run.first, run.count);
+    } else {
+        target.draw(vertices.data() + run.first, run.count, type);
+    }
+    ++batchDrawCalls_;
+    Profiler::count(Profiler::Counter::DrawCalls);
+}
+
+} // namespace xsmall_hmi
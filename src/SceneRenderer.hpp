@@ -0,0 +1,119 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include "VisualObject.hpp"
+#include "SceneStore.hpp"
+
+namespace xsmall_hmi {
+
+// Retained-mode renderer. Untextured geometry of all objects is kept in one
+// triangle buffer and one line buffer; only objects whose geometry version
+// changed are re-tessellated. Drawing walks the objects in stacking order as
+// runs: consecutive parts of the same kind (triangles, lines, one texture,
+// overlays) share a draw call, so the result matches drawing every object on
+// its own while a uniform scene still costs a handful of calls.
+//
+// update() also collects damage: the old and new draw bounds of every object
+// that changed, appeared or went away since clearDamage(), so a caller that
+// keeps its previous frame only has to repaint those areas.
+class SceneRenderer {
+public:
+    // Brings the batches up to date and adds the changed areas to the damage
+    void update(const SceneStore& objects);
+    // Draws the state of the last update(); overlays only of objects
+    // reaching into `clip`
+    void draw(sf::RenderTarget& target, const sf::FloatRect& clip);
+    void draw(sf::RenderTarget& target);
+    // update(), draw() and clearDamage() for callers redrawing everything
+    void render(sf::RenderTarget& target, const SceneStore& objects);
+    
+    // Areas whose pixels changed, in scene coordinates; collapses into
+    // their bounding box beyond MaxDamageRects
+    const std::vector<sf::FloatRect>& getDamage() const { return damage_; }
+    // Set until the first clearDamage(): nothing has been drawn yet
+    bool isFullyDamaged() const { return fullDamage_; }
+    bool hasDamage() const { return fullDamage_ || !damage_.empty(); }
+    void clearDamage();
+    
+    static constexpr std::size_t MaxDamageRects = 8;
+    
+    std::size_t getBatchDrawCalls() const { return batchDrawCalls_; }
+    std::size_t getTriangleVertexCount() const { return triangles_.size(); }
+    std::size_t getLineVertexCount() const { return lines_.size(); }
+    
+private:
+    struct Entry {
+        const VisualObject* object = nullptr;
+        std::uint32_t version = 0;
+        std::size_t triangleOffset = 0;
+        std::size_t triangleCount = 0;
+        std::size_t lineOffset = 0;
+        std::size_t lineCount = 0;
+        sf::FloatRect bounds;
+        bool textured = false;
+        bool overlay = false;
+    };
+    
+    // One draw call: vertices [first, first + count) of the kind's buffer,
+    // or for overlays the entries listed in overlayOrder_[first, first + count)
+    struct Run {
+        enum class Kind { Triangles, Lines, Textured, Overlay };
+        
+        Kind kind = Kind::Triangles;
+        std::size_t first = 0;
+        std::size_t count = 0;
+        const sf::Texture* texture = nullptr;
+    };
+    
+    // Keeps offsets of the previous layout: [first, last) of changed vertices
+    struct DirtyRange {
+        std::size_t first = SIZE_MAX;
+        std::size_t last = 0;
+        
+        void add(std::size_t offset, std::size_t count);
+        bool empty() const { return first >= last; }
+    };
+    
+    bool layoutMatches(const SceneStore& objects) const;
+    bool refreshChanged(const SceneStore& objects);
+    void relayout(const SceneStore& objects);
+    void rebuildRuns();
+    void upload();
+    void addDamage(const sf::FloatRect& rect);
+    void drawRun(sf::RenderTarget& target, sf::VertexBuffer& buffer,
+                 const std::vector<sf::Vertex>& vertices, const Run& run, sf::PrimitiveType type);
+    void drawOverlays(sf::RenderTarget& target, const Run& run, const sf::FloatRect& clip) const;
+    
+    std::vector<Entry> entries_;
+    std::vector<sf::Vertex> triangles_;
+    std::vector<sf::Vertex> lines_;
+    std::vector<sf::Vertex> scratchTriangles_;
+    std::vector<sf::Vertex> scratchLines_;
+    std::vector<sf::Vertex> scratchTextured_;
+    
+    // Textured quads in stacking order; few objects are textured, so they
+    // are collected again whenever one of them changes
+    std::vector<sf::Vertex> textured_;
+    // Entry indices of overlays, grouped by run
+    std::vector<std::size_t> overlayOrder_;
+    std::vector<Run> runs_;
+    bool runsDirty_ = true;
+    
+    DirtyRange dirtyTriangles_;
+    DirtyRange dirtyLines_;
+    bool fullUpload_ = true;
+    
+    bool buffersChecked_ = false;
+    bool useVertexBuffers_ = false;
+    sf::VertexBuffer triangleBuffer_{sf::PrimitiveType::Triangles, sf::VertexBuffer::Usage::Dynamic};
+    sf::VertexBuffer lineBuffer_{sf::PrimitiveType::Lines, sf::VertexBuffer::Usage::Dynamic};
+    
+    std::vector<sf::FloatRect> damage_;
+    bool fullDamage_ = true;
+    
+    std::size_t batchDrawCalls_ = 0;
+};
+
+} // namespace xsmall_hmi
@@ -0,0 +1,201 @@
+#include "SceneStore.hpp"
+#include <algorithm>
+
+namespace xsmall_hmi {
+
+namespace {
+
+// Swap-and-pop: the last element fills index
+template<typename T>
+void removeAt(std::vector<T>& values, std::size_t index) {
+    if (index + 1 != values.size()) {
+        values[index] = std::move(values.back());
+    }
+    values.pop_back();
+}
+
+} // namespace
+
+ObjectPool::ObjectPool(std::size_t blockSize, std::size_t blocksPerChunk)
+    : blocksPerChunk_(std::max<std::size_t>(blocksPerChunk, 1)) {
+    // Every block is aligned for any object and large enough for a free-list link
+    const std::size_t align = alignof(std::max_align_t);
+    blockSize = std::max(blockSize, sizeof(FreeBlock));
+    blockSize_ = (blockSize + align - 1) / align * align;
+}
+
+void* ObjectPool::allocate() {
+    if (freeList_) {
+        FreeBlock* block = freeList_;
+        freeList_ = block->next;
+        return block;
+    }
+    
+    if (chunks_.empty() || usedInLastChunk_ == blocksPerChunk_) {
+        std::size_t bytes = blockSize_ * blocksPerChunk_;
+        std::size_t units = (bytes + sizeof(std::max_align_t) - 1) / sizeof(std::max_align_t);
+        chunks_.push_back(std::make_unique<std::max_align_t[]>(units));
+        usedInLastChunk_ = 0;
+    }
+    
+    auto* base = reinterpret_cast<std::byte*>(chunks_.back().get());
+    return base + blockSize_ * usedInLastChunk_++;
+}
+
+void ObjectPool::deallocate(void* block) {
+    freeList_ = new (block) FreeBlock{freeList_};
+}
+
+SceneStore::~SceneStore() {
+    clear();
+}
+
+ObjectPool& SceneStore::poolFor(ObjectType type, std::size_t size) {
+    auto& pool = pools_[static_cast<std::size_t>(type)];
+    if (!pool) {
+        pool = std::make_unique<ObjectPool>(size);
+    }
+    return *pool;
+}
+
+void SceneStore::attach(VisualObject* object) {
+    std::uint32_t slot;
+    if (!freeSlots_.empty()) {
+        slot = freeSlots_.back();
+        freeSlots_.pop_back();
+    } else {
+        slot = static_cast<std::uint32_t>(slots_.size());
+        slots_.emplace_back();
+    }
+    
+    slots_[slot].dense = static_cast<std::uint32_t>(objects_.size());
+    slots_[slot].alive = true;
+    object->store_ = this;
+    object->storeSlot_ = slot;
+    
+    objects_.push_back(object);
+    positions_.push_back(object->getPosition());
+    sizes_.push_back(object->getSize());
+    colors_.push_back(object->getColor());
+    boundIds_.push_back(object->getBoundId());
+    geometryVersions_.push_back(object->getGeometryVersion());
+    updatesPending_.push_back(object->updatePending_);
+    denseToSlot_.push_back(slot);
+}
+
+void SceneStore::destroy(ObjectHandle handle) {
+    VisualObject* object = get(handle);
+    if (!object) return;
+    
+    const std::uint32_t dense = slots_[object->storeSlot_].dense;
+    removeAt(objects_, dense);
+    removeAt(positions_, dense);
+    removeAt(sizes_, dense);
+    removeAt(colors_, dense);
+    removeAt(boundIds_, dense);
+    removeAt(geometryVersions_, dense);
+    removeAt(updatesPending_, dense);
+    removeAt(denseToSlot_, dense);
+    if (dense < denseToSlot_.size()) {
+        slots_[denseToSlot_[dense]].dense = dense;
+    }
+    
+    // The destructor leaves the tracker and the spatial index; nothing it
+    // does may write through to the arrays any more
+    object->store_ = nullptr;
+    ObjectType type = object->getType();
+    object->~VisualObject();
+    pools_[static_cast<std::size_t>(type)]->deallocate(object);
+    release(handle.index);
+}
+
+void SceneStore::clear() {
+    for (std::size_t i = 0; i < objects_.size(); ++i) {
+        VisualObject* object = objects_[i];
+        object->store_ = nullptr;
+        ObjectType type = object->getType();
+        object->~VisualObject();
+        pools_[static_cast<std::size_t>(type)]->deallocate(object);
+        release(denseToSlot_[i]);
+    }
+    
+    objects_.clear();
+    positions_.clear();
+    sizes_.clear();
+    colors_.clear();
+    boundIds_.clear();
+    geometryVersions_.clear();
+    updatesPending_.clear();
+    denseToSlot_.clear();
+}
+
+void SceneStore::release(std::uint32_t slot) {
+    slots_[slot].alive = false;
+    // A new generation invalidates every handle to the old object
+    ++slots_[slot].generation;
+    freeSlots_.push_back(slot);
+}
+
+VisualObject* SceneStore::get(ObjectHandle handle) const {
+    if (handle.index >= slots_.size()) return nullptr;
+    const Slot& slot = slots_[handle.index];
+    if (!slot.alive || slot.generation != handle.generation) return nullptr;
+    return objects_[slot.dense];
+}
+
+ObjectHandle SceneStore::handleOf(const VisualObject* object) const {
+    if (!object || object->store_ != this) return ObjectHandle();
+    return ObjectHandle{object->storeSlot_, slots_[object->storeSlot_].generation};
+}
+
+void SceneStore::queryRect(const sf::FloatRect& rect, std::vector<VisualObject*>& out) const {
+    const float left = rect.position.x;
+    const float top = rect.position.y;
+    const float right = left + rect.size.x;
+    const float bottom = top + rect.size.y;
+    
+    for (std::size_t i = 0; i < positions_.size(); ++i) {
+        const sf::Vector2f& pos = positions_[i];
+        const sf::Vector2f& size = sizes_[i];
+        if (pos.x <= right && pos.x + size.x >= left &&
+            pos.y <= bottom && pos.y + size.y >= top) {
+            out.push_back(objects_[i]);
+        }
+    }
+}
+
+std::size_t SceneStore::poolChunkCount() const {
+    std::size_t chunks = 0;
+    for (const auto& pool : pools_) {
+        if (pool) chunks += pool->chunkCount();
+    }
+    return chunks;
+}
+
+std::uint32_t SceneStore::denseIndex(const VisualObject& object) const {
+    return slots_[object.storeSlot_].dense;
+}
+
+void SceneStore::syncBounds(const VisualObject& object) {
+    std::uint32_t dense = denseIndex(object);
+    positions_[dense] = object.getPosition();
+    sizes_[dense] = object.getSize();
+}
+
+void SceneStore::syncColor(const VisualObject& object) {
+    colors_[denseIndex(object)] = object.getColor();
+}
+
+void SceneStore::syncBinding(const VisualObject& object) {
+    boundIds_[denseIndex(object)] = object.getBoundId();
+}
+
+void SceneStore::syncGeometryVersion(const VisualObject& object) {
+    geometryVersions_[denseIndex(object)] = object.getGeometryVersion();
+}
+
+void SceneStore::syncUpdatePending(const VisualObject& object) {
+    updatesPending_[denseIndex(object)] = object.updatePending_;
+}
+
+} // namespace xsmall_hmi
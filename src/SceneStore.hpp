@@ -0,0 +1,161 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+#include "VariableDatabase.hpp"
+#include "VisualObject.hpp"
+
+namespace xsmall_hmi {
+
+// Stable reference to an object in a SceneStore. A handle outlives its
+// object safely: once the object is destroyed, lookups return null even if
+// the slot is reused.
+struct ObjectHandle {
+    static constexpr std::uint32_t InvalidIndex = UINT32_MAX;
+    
+    std::uint32_t index = InvalidIndex;
+    std::uint32_t generation = 0;
+    
+    bool isValid() const { return index != InvalidIndex; }
+    bool operator==(const ObjectHandle& other) const {
+        return index == other.index && generation == other.generation;
+    }
+    bool operator!=(const ObjectHandle& other) const { return !(*this == other); }
+};
+
+// Fixed-size blocks carved out of large chunks. Freed blocks are reused
+// before new chunks are allocated, so a scene costs a handful of
+// allocations instead of one per object.
+class ObjectPool {
+public:
+    explicit ObjectPool(std::size_t blockSize = 0, std::size_t blocksPerChunk = 256);
+    ObjectPool(const ObjectPool&) = delete;
+    ObjectPool& operator=(const ObjectPool&) = delete;
+    ObjectPool(ObjectPool&&) = default;
+    ObjectPool& operator=(ObjectPool&&) = default;
+    
+    void* allocate();
+    void deallocate(void* block);
+    
+    std::size_t blockSize() const { return blockSize_; }
+    std::size_t chunkCount() const { return chunks_.size(); }
+    
+private:
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+    
+    std::size_t blockSize_;
+    std::size_t blocksPerChunk_;
+    std::vector<std::unique_ptr<std::max_align_t[]>> chunks_;
+    std::size_t usedInLastChunk_ = 0;
+    FreeBlock* freeList_ = nullptr;
+};
+
+// Owns the objects of a scene. Objects live in per-type pools; the hot
+// fields read by per-frame loops (bounds, color, binding, geometry version,
+// pending update) are mirrored into dense arrays in draw order, which
+// VisualObject keeps up to date through its setters.
+class SceneStore {
+public:
+    SceneStore() = default;
+    ~SceneStore();
+    SceneStore(const SceneStore&) = delete;
+    SceneStore& operator=(const SceneStore&) = delete;
+    
+    // Appends a new object on top of the draw order
+    template<typename T, typename... Args>
+    T* create(Args&&... args);
+    // Constant time: the topmost object takes the destroyed one's place in
+    // the draw order
+    void destroy(ObjectHandle handle);
+    void clear();
+    
+    VisualObject* get(ObjectHandle handle) const;
+    template<typename T>
+    T* get(ObjectHandle handle) const { return objectCast<T>(get(handle)); }
+    // Invalid for objects that are not in this store
+    ObjectHandle handleOf(const VisualObject* object) const;
+    
+    std::size_t size() const { return objects_.size(); }
+    bool empty() const { return objects_.empty(); }
+    
+    // Dense arrays, all indexed by draw order
+    const std::vector<VisualObject*>& objects() const { return objects_; }
+    const std::vector<sf::Vector2f>& positions() const { return positions_; }
+    const std::vector<sf::Vector2f>& sizes() const { return sizes_; }
+    const std::vector<sf::Color>& colors() const { return colors_; }
+    const std::vector<VariableId>& boundIds() const { return boundIds_; }
+    const std::vector<std::uint32_t>& geometryVersions() const { return geometryVersions_; }
+    // Nonzero while a BindingTracker has the object queued for update()
+    const std::vector<std::uint8_t>& updatesPending() const { return updatesPending_; }
+    
+    std::vector<VisualObject*>::const_iterator begin() const { return objects_.begin(); }
+    std::vector<VisualObject*>::const_iterator end() const { return objects_.end(); }
+    
+    // Objects whose bounds intersect rect, in draw order; a linear scan over
+    // the packed bounds, meant for culling against the view
+    void queryRect(const sf::FloatRect& rect, std::vector<VisualObject*>& out) const;
+    
+    std::size_t poolChunkCount() const;
+    
+private:
+    friend class VisualObject;
+    
+    static constexpr std::size_t TypeCount = static_cast<std::size_t>(ObjectType::Image) + 1;
+    
+    struct Slot {
+        std::uint32_t dense = 0;
+        std::uint32_t generation = 0;
+        bool alive = false;
+    };
+    
+    ObjectPool& poolFor(ObjectType type, std::size_t size);
+    void attach(VisualObject* object);
+    void release(std::uint32_t slot);
+    
+    // Write-through from VisualObject
+    void syncBounds(const VisualObject& object);
+    void syncColor(const VisualObject& object);
+    void syncBinding(const VisualObject& object);
+    void syncGeometryVersion(const VisualObject& object);
+    void syncUpdatePending(const VisualObject& object);
+    std::uint32_t denseIndex(const VisualObject& object) const;
+    
+    std::vector<VisualObject*> objects_;
+    std::vector<sf::Vector2f> positions_;
+    std::vector<sf::Vector2f> sizes_;
+    std::vector<sf::Color> colors_;
+    std::vector<VariableId> boundIds_;
+    std::vector<std::uint32_t> geometryVersions_;
+    // Bytes, not vector<bool>: parallel updates clear neighbouring entries
+    std::vector<std::uint8_t> updatesPending_;
+    std::vector<std::uint32_t> denseToSlot_;
+    
+    std::vector<Slot> slots_;
+    std::vector<std::uint32_t> freeSlots_;
+    std::array<std::unique_ptr<ObjectPool>, TypeCount> pools_;
+};
+
+template<typename T, typename... Args>
+T* SceneStore::create(Args&&... args) {
+    static_assert(alignof(T) <= alignof(std::max_align_t), "pool blocks are max_align_t aligned");
+    ObjectPool& pool = poolFor(T::StaticType, sizeof(T));
+    void* block = pool.allocate();
+    T* object;
+    try {
+        object = new (block) T(std::forward<Args>(args)...);
+    } catch (...) {
+        pool.deallocate(block);
+        throw;
+    }
+    attach(object);
+    return object;
+}
+
+} // namespace xsmall_hmi
@@ -0,0 +1,110 @@
+#pragma once
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace xsmall_hmi {
+
+template<typename Signature, std::size_t Capacity = 4 * sizeof(void*)>
+class SmallFunction;
+
+// Move-only std::function replacement that keeps callables of up to
+// Capacity bytes (a lambda capturing a few pointers or ids) inside the
+// object, so storing one never allocates. Larger callables, or ones whose
+// move can throw, fall back to the heap.
+template<typename R, typename... Args, std::size_t Capacity>
+class SmallFunction<R(Args...), Capacity> {
+public:
+    template<typename F>
+    static constexpr bool storesInline =
+        sizeof(F) <= Capacity && alignof(F) <= alignof(std::max_align_t) &&
+        std::is_nothrow_move_constructible_v<F>;
+    
+    SmallFunction() noexcept = default;
+    SmallFunction(std::nullptr_t) noexcept {}
+    
+    template<typename F, typename Fn = std::decay_t<F>,
+             typename = std::enable_if_t<!std::is_same_v<Fn, SmallFunction> &&
+                                         std::is_invocable_r_v<R, Fn&, Args...>>>
+    SmallFunction(F&& f) {
+        if constexpr (storesInline<Fn>) {
+            ::new (static_cast<void*>(storage_)) Fn(std::forward<F>(f));
+            ops_ = &inlineOps<Fn>;
+        } else {
+            ::new (static_cast<void*>(storage_)) Fn*(new Fn(std::forward<F>(f)));
+            ops_ = &heapOps<Fn>;
+        }
+    }
+    
+    SmallFunction(SmallFunction&& other) noexcept : ops_(other.ops_) {
+        if (ops_) {
+            ops_->move(other.storage_, storage_);
+            other.ops_ = nullptr;
+        }
+    }
+    
+    SmallFunction& operator=(SmallFunction&& other) noexcept {
+        if (this != &other) {
+            reset();
+            if (other.ops_) {
+                other.ops_->move(other.storage_, storage_);
+                ops_ = other.ops_;
+                other.ops_ = nullptr;
+            }
+        }
+        return *this;
+    }
+    
+    SmallFunction(const SmallFunction&) = delete;
+    SmallFunction& operator=(const SmallFunction&) = delete;
+    
+    ~SmallFunction() { reset(); }
+    
+    void reset() noexcept {
+        if (ops_) {
+            ops_->destroy(storage_);
+            ops_ = nullptr;
+        }
+    }
+    
+    explicit operator bool() const noexcept { return ops_ != nullptr; }
+    
+    R operator()(Args... args) const {
+        return ops_->invoke(storage_, std::forward<Args>(args)...);
+    }
+    
+private:
+    struct Ops {
+        R (*invoke)(void* storage, Args&&... args);
+        // Move-constructs into `to` and destroys what is left in `from`
+        void (*move)(void* from, void* to) noexcept;
+        void (*destroy)(void* storage) noexcept;
+    };
+    
+    template<typename Fn>
+    static constexpr Ops inlineOps = {
+        [](void* storage, Args&&... args) -> R {
+            return (*static_cast<Fn*>(storage))(std::forward<Args>(args)...);
+        },
+        [](void* from, void* to) noexcept {
+            ::new (to) Fn(std::move(*static_cast<Fn*>(from)));
+            static_cast<Fn*>(from)->~Fn();
+        },
+        [](void* storage) noexcept { static_cast<Fn*>(storage)->~Fn(); }
+    };
+    
+    template<typename Fn>
+    static constexpr Ops heapOps = {
+        [](void* storage, Args&&... args) -> R {
+            return (**static_cast<Fn**>(storage))(std::forward<Args>(args)...);
+        },
+        [](void* from, void* to) noexcept { ::new (to) Fn*(*static_cast<Fn**>(from)); },
+        [](void* storage) noexcept { delete *static_cast<Fn**>(storage); }
+    };
+    
+    alignas(std::max_align_t) mutable unsigned char storage_[Capacity];
+    const Ops* ops_ = nullptr;
+};
+
+} // namespace xsmall_hmi
@@ -0,0 +1,154 @@
+#include "SpatialIndex.hpp"
+#include "VisualObject.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace xsmall_hmi {
+
+SpatialIndex::SpatialIndex(float cellSize)
+    : cellSize_(cellSize) {
+}
+
+void SpatialIndex::insert(VisualObject* object) {
+    if (records_.count(object)) {
+        update(object);
+        return;
+    }
+    
+    Record record;
+    record.bounds = object->getBounds();
+    record.cells = cellsFor(record.bounds);
+    record.order = nextOrder_++;
+    records_.emplace(object, record);
+    
+    addToCells(object, record.cells);
+    object->spatialIndex_ = this;
+}
+
+void SpatialIndex::remove(VisualObject* object) {
+    auto it = records_.find(object);
+    if (it == records_.end()) return;
+    
+    removeFromCells(object, it->second.cells);
+    records_.erase(it);
+    object->spatialIndex_ = nullptr;
+}
+
+void SpatialIndex::update(VisualObject* object) {
+    auto it = records_.find(object);
+    if (it == records_.end()) return;
+    
+    Record& record = it->second;
+    record.bounds = object->getBounds();
+    
+    CellRange cells = cellsFor(record.bounds);
+    if (cells.minX != record.cells.minX || cells.minY != record.cells.minY ||
+        cells.maxX != record.cells.maxX || cells.maxY != record.cells.maxY) {
+        removeFromCells(object, record.cells);
+        addToCells(object, cells);
+        record.cells = cells;
+    }
+}
+
+void SpatialIndex::clear() {
+    for (auto& [object, record] : records_) {
+        const_cast<VisualObject*>(object)->spatialIndex_ = nullptr;
+    }
+    records_.clear();
+    cells_.clear();
+}
+
+void SpatialIndex::queryPoint(const sf::Vector2f& point, std::vector<VisualObject*>& out) const {
+    std::size_t from = out.size();
+    
+    int x = static_cast<int>(std::floor(point.x / cellSize_));
+    int y = static_cast<int>(std::floor(point.y / cellSize_));
+    auto cell = cells_.find(cellKey(x, y));
+    if (cell == cells_.end()) return;
+    
+    for (VisualObject* object : cell->second) {
+        if (object->contains(point)) {
+            out.push_back(object);
+        }
+    }
+    sortTopmostFirst(out, from);
+}
+
+void SpatialIndex::queryRect(const sf::FloatRect& rect, std::vector<VisualObject*>& out) const {
+    std::size_t from = out.size();
+    CellRange range = cellsFor(rect);
+    
+    for (int y = range.minY; y <= range.maxY; ++y) {
+        for (int x = range.minX; x <= range.maxX; ++x) {
+            auto cell = cells_.find(cellKey(x, y));
+            if (cell == cells_.end()) continue;
+            
+            for (VisualObject* object : cell->second) {
+                // Objects spanning several cells are reported from their first one only
+                const CellRange& cells = records_.at(object).cells;
+                if (x != std::max(cells.minX, range.minX) || y != std::max(cells.minY, range.minY)) {
+                    continue;
+                }
+                if (object->getBounds().findIntersection(rect)) {
+                    out.push_back(object);
+                }
+            }
+        }
+    }
+    sortTopmostFirst(out, from);
+}
+
+SpatialIndex::CellRange SpatialIndex::cellsFor(const sf::FloatRect& rect) const {
+    float left = std::min(rect.position.x, rect.position.x + rect.size.x);
+    float top = std::min(rect.position.y, rect.position.y + rect.size.y);
+    float right = std::max(rect.position.x, rect.position.x + rect.size.x);
+    float bottom = std::max(rect.position.y, rect.position.y + rect.size.y);
+    
+    CellRange cells;
+    cells.minX = static_cast<int>(std::floor(left / cellSize_));
+    cells.minY = static_cast<int>(std::floor(top / cellSize_));
+    cells.maxX = static_cast<int>(std::floor(right / cellSize_));
+    cells.maxY = static_cast<int>(std::floor(bottom / cellSize_));
+    return cells;
+}
+
+std::uint64_t SpatialIndex::cellKey(int x, int y) {
+    return (static_cast<std::uint64_t>(static_cast<std::uint32_t>(x)) << 32) |
+           static_cast<std::uint32_t>(y);
+}
+
+void SpatialIndex::addToCells(VisualObject* object, const CellRange& cells) {
+    for (int y = cells.minY; y <= cells.maxY; ++y) {
+        for (int x = cells.minX; x <= cells.maxX; ++x) {
+            cells_[cellKey(x, y)].push_back(object);
+        }
+    }
+}
+
+void SpatialIndex::removeFromCells(VisualObject* object, const CellRange& cells) {
+    for (int y = cells.minY; y <= cells.maxY; ++y) {
+        for (int x = cells.minX; x <= cells.maxX; ++x) {
+            auto cell = cells_.find(cellKey(x, y));
+            if (cell == cells_.end()) continue;
+            
+            auto& objects = cell->second;
+            auto it = std::find(objects.begin(), objects.end(), object);
+            if (it != objects.end()) {
+                *it = objects.back();
+                objects.pop_back();
+            }
+            if (objects.empty()) {
+                cells_.erase(cell);
+            }
+        }
+    }
+}
+
+void SpatialIndex::sortTopmostFirst(std::vector<VisualObject*>& objects, std::size_t from) const {
+    std::sort(objects.begin() + from, objects.end(),
+              [this](const VisualObject* a, const VisualObject* b) {
+                  return records_.at(a).order > records_.at(b).order;
+              });
+}
+
+} // namespace xsmall_hmi
@@ -0,0 +1,54 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace xsmall_hmi {
+
+class VisualObject;
+
+// Uniform grid over object bounds. Point and rectangle queries only visit the
+// cells they overlap, so hit-testing cost depends on local density rather
+// than on scene size. Results are ordered topmost (latest inserted) first.
+class SpatialIndex {
+public:
+    explicit SpatialIndex(float cellSize = 128.0f);
+    
+    void insert(VisualObject* object);
+    void remove(VisualObject* object);
+    void update(VisualObject* object);
+    void clear();
+    
+    void queryPoint(const sf::Vector2f& point, std::vector<VisualObject*>& out) const;
+    void queryRect(const sf::FloatRect& rect, std::vector<VisualObject*>& out) const;
+    
+    std::size_t size() const { return records_.size(); }
+    
+private:
+    struct CellRange {
+        int minX = 0;
+        int minY = 0;
+        int maxX = -1;
+        int maxY = -1;
+    };
+    
+    struct Record {
+        sf::FloatRect bounds;
+        CellRange cells;
+        std::uint64_t order = 0;
+    };
+    
+    CellRange cellsFor(const sf::FloatRect& rect) const;
+    static std::uint64_t cellKey(int x, int y);
+    void addToCells(VisualObject* object, const CellRange& cells);
+    void removeFromCells(VisualObject* object, const CellRange& cells);
+    void sortTopmostFirst(std::vector<VisualObject*>& objects, std::size_t from) const;
+    
+    float cellSize_;
+    std::uint64_t nextOrder_ = 0;
+    std::unordered_map<std::uint64_t, std::vector<VisualObject*>> cells_;
+    std::unordered_map<const VisualObject*, Record> records_;
+};
+
+} // namespace xsmall_hmi
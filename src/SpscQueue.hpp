@@ -0,0 +1,96 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <utility>
+
+namespace xsmall_hmi {
+
+// Bounded lock-free queue for exactly one producer thread and one consumer
+// thread. Capacity is rounded up to a power of two. Head and tail sit on
+// separate cache lines, and each side caches the other's index so it only
+// touches the shared line when the cached value says the queue looks
+// full (producer) or empty (consumer).
+template<typename T>
+class SpscQueue {
+public:
+    explicit SpscQueue(std::size_t capacity)
+        : capacity_(roundUp(capacity)), mask_(capacity_ - 1),
+          slots_(std::make_unique<std::optional<T>[]>(capacity_)) {
+    }
+    
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+    
+    // Producer side; false when the queue is full
+    bool tryPush(T value) {
+        const std::size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - cachedHead_ == capacity_) {
+            cachedHead_ = head_.load(std::memory_order_acquire);
+            if (tail - cachedHead_ == capacity_) return false;
+        }
+        slots_[tail & mask_].emplace(std::move(value));
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+    
+    // Consumer side; nothing when the queue is empty
+    std::optional<T> tryPop() {
+        const std::size_t head = head_.load(std::memory_order_relaxed);
+        if (head == cachedTail_) {
+            cachedTail_ = tail_.load(std::memory_order_acquire);
+            if (head == cachedTail_) return std::nullopt;
+        }
+        std::optional<T>& slot = slots_[head & mask_];
+        std::optional<T> value(std::move(slot));
+        slot.reset();
+        head_.store(head + 1, std::memory_order_release);
+        return value;
+    }
+    
+    // Consumer side: pops up to maxCount items into fn(T&&)
+    template<typename Fn>
+    std::size_t drain(Fn&& fn, std::size_t maxCount = SIZE_MAX) {
+        const std::size_t head = head_.load(std::memory_order_relaxed);
+        const std::size_t tail = tail_.load(std::memory_order_acquire);
+        cachedTail_ = tail;
+        const std::size_t count = std::min(tail - head, maxCount);
+        for (std::size_t i = 0; i < count; ++i) {
+            std::optional<T>& slot = slots_[(head + i) & mask_];
+            fn(std::move(*slot));
+            slot.reset();
+        }
+        // One release for the whole batch
+        head_.store(head + count, std::memory_order_release);
+        return count;
+    }
+    
+    std::size_t capacity() const { return capacity_; }
+    // Approximate when called concurrently with push or pop
+    std::size_t size() const {
+        return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+    }
+    
+private:
+    static std::size_t roundUp(std::size_t capacity) {
+        std::size_t rounded = 2;
+        while (rounded < capacity) rounded <<= 1;
+        return rounded;
+    }
+    
+    static constexpr std::size_t CacheLine = 64;
+    
+    const std::size_t capacity_;
+    const std::size_t mask_;
+    std::unique_ptr<std::optional<T>[]> slots_;
+    
+    alignas(CacheLine) std::atomic<std::size_t> head_{0};
+    std::size_t cachedTail_ = 0;    // consumer's copy of tail_
+    alignas(CacheLine) std::atomic<std::size_t> tail_{0};
+    std::size_t cachedHead_ = 0;    // producer's copy of head_
+};
+
+} // namespace xsmall_hmi
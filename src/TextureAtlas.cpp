@@ -0,0 +1,85 @@
+#include "TextureAtlas.hpp"
+#include <algorithm>
+
+namespace xsmall_hmi {
+
+namespace {
+
+// Keeps linear filtering from sampling a neighbouring image
+const unsigned Padding = 1;
+
+} // namespace
+
+ShelfPacker::ShelfPacker(sf::Vector2u size)
+    : size_(size) {
+}
+
+std::optional<sf::Vector2u> ShelfPacker::insert(sf::Vector2u size) {
+    if (size.x > size_.x || size.y > size_.y) return std::nullopt;
+    
+    // Best fit: the lowest shelf that is tall enough wastes the least height
+    Shelf* best = nullptr;
+    for (auto& shelf : shelves_) {
+        if (shelf.height >= size.y && size_.x - shelf.usedWidth >= size.x &&
+            (!best || shelf.height < best->height)) {
+            best = &shelf;
+        }
+    }
+    
+    if (!best) {
+        if (size_.y - nextShelfY_ < size.y) return std::nullopt;
+        shelves_.push_back({nextShelfY_, size.y, 0});
+        nextShelfY_ += size.y;
+        best = &shelves_.back();
+    }
+    
+    sf::Vector2u position(best->usedWidth, best->y);
+    best->usedWidth += size.x;
+    return position;
+}
+
+TextureAtlas::TextureAtlas(unsigned pageSize)
+    : pageSize_(pageSize) {
+}
+
+std::optional<TextureAtlas::Region> TextureAtlas::add(const sf::Image& image) {
+    const sf::Vector2u imageSize = image.getSize();
+    if (imageSize.x == 0 || imageSize.y == 0) return std::nullopt;
+    
+    const sf::Vector2u padded(imageSize.x + Padding, imageSize.y + Padding);
+    std::optional<sf::Vector2u> position;
+    Page* page = nullptr;
+    
+    for (auto& candidate : pages_) {
+        if ((position = candidate.packer.insert(padded))) {
+            page = &candidate;
+            break;
+        }
+    }
+    
+    if (!page) {
+        sf::Vector2u pageSize(std::max(pageSize_, padded.x), std::max(pageSize_, padded.y));
+        page = createPage(pageSize);
+        if (!page) return std::nullopt;
+        position = page->packer.insert(padded);
+        if (!position) return std::nullopt;
+    }
+    
+    page->texture->update(image, *position);
+    return Region{page->texture.get(),
+                  sf::IntRect(sf::Vector2i(*position), sf::Vector2i(imageSize))};
+}
+
+TextureAtlas::Page* TextureAtlas::createPage(sf::Vector2u size) {
+    const unsigned maximum = sf::Texture::getMaximumSize();
+    if (size.x > maximum || size.y > maximum) return nullptr;
+    
+    auto texture = std::make_unique<sf::Texture>();
+    if (!texture->resize(size)) return nullptr;
+    texture->setSmooth(true);
+    
+    pages_.push_back(Page{std::move(texture), ShelfPacker(size)});
+    return &pages_.back();
+}
+
+} // namespace xsmall_hmi
@@ -0,0 +1,58 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <memory>
+#include <optional>
+#include <vector>
+
+namespace xsmall_hmi {
+
+// Shelf packing: rectangles go left to right on horizontal shelves; a new
+// shelf opens below the last one when no existing shelf has room.
+class ShelfPacker {
+public:
+    explicit ShelfPacker(sf::Vector2u size);
+    
+    // Top-left corner of the reserved area, or nothing when the page is full
+    std::optional<sf::Vector2u> insert(sf::Vector2u size);
+    
+private:
+    struct Shelf {
+        unsigned y;
+        unsigned height;
+        unsigned usedWidth;
+    };
+    
+    sf::Vector2u size_;
+    std::vector<Shelf> shelves_;
+    unsigned nextShelfY_ = 0;
+};
+
+// Packs many small images into a few large textures so that images sharing
+// a page render in one batch. Must be used on the thread owning the GL
+// context. Space is never reclaimed.
+class TextureAtlas {
+public:
+    struct Region {
+        const sf::Texture* texture = nullptr;
+        sf::IntRect rect;
+    };
+    
+    explicit TextureAtlas(unsigned pageSize = 1024);
+    
+    // Images larger than a page get a page of their own
+    std::optional<Region> add(const sf::Image& image);
+    std::size_t pageCount() const { return pages_.size(); }
+    
+private:
+    struct Page {
+        std::unique_ptr<sf::Texture> texture;
+        ShelfPacker packer;
+    };
+    
+    Page* createPage(sf::Vector2u size);
+    
+    unsigned pageSize_;
+    std::vector<Page> pages_;
+};
+
+} // namespace xsmall_hmi
@@ -0,0 +1,96 @@
+#include "ThreadPool.hpp"
+
+namespace xsmall_hmi {
+
+ThreadPool::ThreadPool(std::size_t workers) {
+    if (workers == 0) {
+        unsigned hardware = std::thread::hardware_concurrency();
+        workers = std::max(1u, hardware > 1 ? hardware - 1 : 1u);
+    }
+    queues_.reserve(workers);
+    for (std::size_t i = 0; i < workers; ++i) {
+        queues_.push_back(std::make_unique<Queue>());
+    }
+    workers_.reserve(workers);
+    for (std::size_t i = 0; i < workers; ++i) {
+        workers_.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    taskAvailable_.notify_all();
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+void ThreadPool::submit(Task task) {
+    {
+        // Counted under mutex_ so a worker about to sleep cannot miss it, and
+        // before the task is visible so the counts never go negative
+        std::lock_guard<std::mutex> lock(mutex_);
+        queued_.fetch_add(1, std::memory_order_relaxed);
+        ++pending_;
+    }
+    Queue& queue = *queues_[nextQueue_.fetch_add(1, std::memory_order_relaxed) % queues_.size()];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(std::move(task));
+    }
+    taskAvailable_.notify_one();
+}
+
+void ThreadPool::wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    idle_.wait(lock, [this] { return pending_ == 0; });
+}
+
+bool ThreadPool::popTask(std::size_t self, Task& task) {
+    {
+        Queue& own = *queues_[self];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.front());
+            own.tasks.pop_front();
+            queued_.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    for (std::size_t i = 1; i < queues_.size(); ++i) {
+        Queue& victim = *queues_[(self + i) % queues_.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.back());
+            victim.tasks.pop_back();
+            queued_.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::workerLoop(std::size_t self) {
+    while (true) {
+        Task task;
+        if (popTask(self, task)) {
+            task();
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (--pending_ == 0) {
+                idle_.notify_all();
+            }
+            continue;
+        }
+        
+        std::unique_lock<std::mutex> lock(mutex_);
+        taskAvailable_.wait(lock, [this] {
+            return stopping_ || queued_.load(std::memory_order_relaxed) > 0;
+        });
+        if (stopping_ && queued_.load(std::memory_order_relaxed) == 0) return;
+    }
+}
+
+} // namespace xsmall_hmi
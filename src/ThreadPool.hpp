@@ -0,0 +1,111 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace xsmall_hmi {
+
+// Fixed set of worker threads with one task deque each. Submitted tasks are
+// spread over the deques round-robin; a worker runs its own tasks in FIFO
+// order and steals from the back of the others' deques when it runs dry, so
+// one long task (an image decode) does not hold up the work queued behind
+// it. parallelFor() splits a range into chunks that the workers and the
+// calling thread claim until none are left.
+class ThreadPool {
+public:
+    using Task = std::function<void()>;
+    
+    // 0 picks one worker per hardware thread, leaving one for the UI
+    explicit ThreadPool(std::size_t workers = 0);
+    // Finishes queued tasks before joining
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    
+    void submit(Task task);
+    // Blocks until the queue is empty and no task is running
+    void wait();
+    
+    // Calls fn(begin, end) for consecutive chunks of at most `grain` indices
+    // covering [0, count); returns once every chunk has run. The calling
+    // thread works too, so this completes even while all workers are busy.
+    template<typename Fn>
+    void parallelFor(std::size_t count, std::size_t grain, Fn&& fn);
+    
+    std::size_t workerCount() const { return workers_.size(); }
+    
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+    
+    // Shared with helper tasks that may start after parallelFor() returned;
+    // those find no chunk left and never touch the body
+    struct Range {
+        std::atomic<std::size_t> next{0};
+        std::atomic<std::size_t> done{0};
+        std::size_t chunks = 0;
+        std::size_t grain = 0;
+        std::size_t count = 0;
+        std::function<void(std::size_t, std::size_t)> body;
+        
+        void run() {
+            for (std::size_t chunk; (chunk = next.fetch_add(1, std::memory_order_relaxed)) < chunks;) {
+                const std::size_t begin = chunk * grain;
+                body(begin, std::min(begin + grain, count));
+                done.fetch_add(1, std::memory_order_release);
+            }
+        }
+    };
+    
+    bool popTask(std::size_t self, Task& task);
+    void workerLoop(std::size_t self);
+    
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> workers_;
+    std::atomic<std::size_t> nextQueue_{0};
+    std::atomic<std::size_t> queued_{0};
+    
+    std::mutex mutex_;
+    std::condition_variable taskAvailable_;
+    std::condition_variable idle_;
+    std::size_t pending_ = 0;   // queued plus running, guarded by mutex_
+    bool stopping_ = false;
+};
+
+template<typename Fn>
+void ThreadPool::parallelFor(std::size_t count, std::size_t grain, Fn&& fn) {
+    grain = std::max<std::size_t>(grain, 1);
+    const std::size_t chunks = (count + grain - 1) / grain;
+    if (chunks <= 1 || workers_.empty()) {
+        if (count > 0) fn(std::size_t(0), count);
+        return;
+    }
+    
+    auto range = std::make_shared<Range>();
+    range->chunks = chunks;
+    range->grain = grain;
+    range->count = count;
+    range->body = [&fn](std::size_t begin, std::size_t end) { fn(begin, end); };
+    
+    const std::size_t helpers = std::min(workers_.size(), chunks - 1);
+    for (std::size_t i = 0; i < helpers; ++i) {
+        submit([range] { range->run(); });
+    }
+    range->run();
+    
+    // The last chunks may still be running on workers
+    while (range->done.load(std::memory_order_acquire) < chunks) {
+        std::this_thread::yield();
+    }
+}
+
+} // namespace xsmall_hmi
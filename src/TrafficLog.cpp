@@ -0,0 +1,271 @@
+#include "TrafficLog.hpp"
+#include "MappedFile.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <type_traits>
+#include <variant>
+
+namespace xsmall_hmi {
+
+namespace {
+
+const char FileMagic[4] = {'X', 'H', 'T', 'R'};
+const std::uint32_t FileVersion = 1;
+const std::size_t FileHeaderSize = 8;
+const std::uint8_t NameRecord = 0;
+const std::size_t FlushThreshold = 64 * 1024;
+
+template<typename T>
+void put(std::vector<std::uint8_t>& out, const T& value) {
+    std::uint8_t bytes[sizeof(T)];
+    std::memcpy(bytes, &value, sizeof(T));
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+template<typename T>
+bool get(const std::uint8_t*& data, const std::uint8_t* end, T& value) {
+    if (static_cast<std::size_t>(end - data) < sizeof(T)) return false;
+    std::memcpy(&value, data, sizeof(T));
+    data += sizeof(T);
+    return true;
+}
+
+void putVarint(std::vector<std::uint8_t>& out, std::uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<std::uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<std::uint8_t>(value));
+}
+
+bool getVarint(const std::uint8_t*& data, const std::uint8_t* end, std::uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64 && data < end; shift += 7) {
+        std::uint8_t byte = *data++;
+        value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+void putString(std::vector<std::uint8_t>& out, const std::string& text) {
+    putVarint(out, text.size());
+    out.insert(out.end(), text.begin(), text.end());
+}
+
+bool getString(const std::uint8_t*& data, const std::uint8_t* end, std::string& text) {
+    std::uint64_t length;
+    if (!getVarint(data, end, length) || length > static_cast<std::uint64_t>(end - data)) return false;
+    text.assign(reinterpret_cast<const char*>(data), static_cast<std::size_t>(length));
+    data += length;
+    return true;
+}
+
+std::uint64_t zigzag(std::int64_t value) {
+    return (static_cast<std::uint64_t>(value) << 1) ^ static_cast<std::uint64_t>(value >> 63);
+}
+
+std::int64_t unzigzag(std::uint64_t value) {
+    return static_cast<std::int64_t>(value >> 1) ^ -static_cast<std::int64_t>(value & 1);
+}
+
+// Payload of the ValueType alternative `kind`
+bool getValue(std::size_t kind, const std::uint8_t*& data, const std::uint8_t* end,
+              VariableDatabase::ValueType& value) {
+    switch (kind) {
+        case 0: {
+            std::uint64_t raw;
+            if (!getVarint(data, end, raw)) return false;
+            value = static_cast<int>(unzigzag(raw));
+            return true;
+        }
+        case 1: {
+            float number;
+            if (!get(data, end, number)) return false;
+            value = number;
+            return true;
+        }
+        case 2: {
+            double number;
+            if (!get(data, end, number)) return false;
+            value = number;
+            return true;
+        }
+        case 3: {
+            std::uint8_t flag;
+            if (!get(data, end, flag)) return false;
+            value = flag != 0;
+            return true;
+        }
+        case 4: {
+            std::string text;
+            if (!getString(data, end, text)) return false;
+            value = std::move(text);
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+} // namespace
+
+bool TrafficLog::open(const std::string& path) {
+    clear();
+    
+    MappedFile map;
+    if (!map.open(path) || map.size() < FileHeaderSize) return false;
+    const std::uint8_t* data = map.data();
+    const std::uint8_t* end = data + map.size();
+    
+    std::uint32_t version;
+    if (std::memcmp(data, FileMagic, 4) != 0) return false;
+    std::memcpy(&version, data + 4, sizeof(version));
+    if (version != FileVersion) return false;
+    data += FileHeaderSize;
+    
+    constexpr std::size_t ValueKinds = std::variant_size_v<VariableDatabase::ValueType>;
+    std::uint64_t time = 0;
+    while (data < end) {
+        const std::uint8_t kind = *data++;
+        std::uint64_t delta = 0;
+        std::uint64_t id;
+        
+        if (kind == NameRecord) {
+            std::string name;
+            if (!getVarint(data, end, id) || !getString(data, end, name)) break;
+            if (id != names_.size()) return false;
+            names_.push_back(std::move(name));
+            continue;
+        }
+        
+        if (kind > ValueKinds) return false;
+        VariableDatabase::ValueType value;
+        if (!getVarint(data, end, delta) || !getVarint(data, end, id) ||
+            !getValue(kind - 1, data, end, value)) {
+            break;
+        }
+        if (id >= names_.size()) return false;
+        time += delta;
+        events_.push_back({time, static_cast<std::uint32_t>(id), std::move(value)});
+    }
+    return true;
+}
+
+void TrafficLog::clear() {
+    names_.clear();
+    events_.clear();
+}
+
+TrafficRecorder::TrafficRecorder(VariableDatabase& db) : db_(db) {
+}
+
+TrafficRecorder::~TrafficRecorder() {
+    stop();
+}
+
+bool TrafficRecorder::start(const std::string& path) {
+    stop();
+    
+    file_ = std::fopen(path.c_str(), "wb");
+    if (!file_) return false;
+    
+    buffer_.assign(FileMagic, FileMagic + 4);
+    put(buffer_, FileVersion);
+    logIds_.clear();
+    nextLogId_ = 0;
+    start_ = std::chrono::steady_clock::now();
+    lastTime_ = 0;
+    events_ = 0;
+    
+    hook_ = db_.addWriteHook([this](VariableId id, const VariableDatabase::ValueType& value, double) {
+        record(id, value);
+    });
+    return true;
+}
+
+void TrafficRecorder::stop() {
+    if (!file_) return;
+    
+    hook_.reset();
+    flush();
+    std::fclose(file_);
+    file_ = nullptr;
+}
+
+void TrafficRecorder::record(VariableId id, const VariableDatabase::ValueType& value) {
+    // Log ids are dense in the order variables are first written, whatever
+    // their database ids; each is named the first time it is written
+    if (id >= logIds_.size()) logIds_.resize(id + 1, UnnamedId);
+    std::uint32_t& logId = logIds_[id];
+    if (logId == UnnamedId) {
+        logId = nextLogId_++;
+        buffer_.push_back(NameRecord);
+        putVarint(buffer_, logId);
+        putString(buffer_, db_.getName(id));
+    }
+    
+    const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start_).count();
+    const std::uint64_t time = std::max<std::uint64_t>(lastTime_, static_cast<std::uint64_t>(elapsed));
+    
+    buffer_.push_back(static_cast<std::uint8_t>(value.index() + 1));
+    putVarint(buffer_, time - lastTime_);
+    putVarint(buffer_, logId);
+    std::visit([this](const auto& v) {
+        using T = std::decay_t<decltype(v)>;
+        if constexpr (std::is_same_v<T, int>) {
+            putVarint(buffer_, zigzag(v));
+        } else if constexpr (std::is_same_v<T, bool>) {
+            buffer_.push_back(v ? 1 : 0);
+        } else if constexpr (std::is_same_v<T, std::string>) {
+            putString(buffer_, v);
+        } else {
+            put(buffer_, v);
+        }
+    }, value);
+    lastTime_ = time;
+    ++events_;
+    
+    if (buffer_.size() >= FlushThreshold) {
+        flush();
+    }
+}
+
+void TrafficRecorder::flush() {
+    if (!buffer_.empty()) {
+        std::fwrite(buffer_.data(), 1, buffer_.size(), file_);
+        buffer_.clear();
+    }
+    std::fflush(file_);
+}
+
+void TrafficReplayer::prepare(VariableDatabase& db) {
+    ids_.clear();
+    for (const std::string& name : log_.names()) {
+        ids_.push_back(db.resolveId(name));
+    }
+}
+
+std::size_t TrafficReplayer::advance(VariableDatabase& db, double seconds) {
+    if (ids_.size() != log_.names().size()) prepare(db);
+    clock_ += static_cast<std::uint64_t>(std::llround(std::max(seconds, 0.0) * 1e6));
+    
+    const auto& events = log_.events();
+    const std::size_t first = next_;
+    db.beginBatch();
+    while (next_ < events.size() && events[next_].time <= clock_) {
+        db.setVariable(ids_[events[next_].variable], events[next_].value);
+        ++next_;
+    }
+    db.commitBatch();
+    return next_ - first;
+}
+
+void TrafficReplayer::rewind() {
+    next_ = 0;
+    clock_ = 0;
+}
+
+} // namespace xsmall_hmi
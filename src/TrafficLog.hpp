@@ -0,0 +1,100 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <string>
+#include <vector>
+#include "VariableDatabase.hpp"
+
+namespace xsmall_hmi {
+
+// Variable traffic captured by TrafficRecorder.
+//
+// File layout: an 8-byte header ("XHTR" + version) followed by records
+// starting with a kind byte. Kind 0 names a variable: [id][length][bytes];
+// ids count up from 0 in the order variables first appear.
+// Kinds 1-5 are writes of the ValueType alternative kind - 1:
+// [time delta in microseconds][id][payload]. Ids, lengths, deltas and ints
+// (zigzag) are varints; floats, doubles and bools are stored raw in host
+// byte order, strings as [length][bytes].
+class TrafficLog {
+public:
+    struct Event {
+        std::uint64_t time;  // microseconds since recording started
+        std::uint32_t variable;  // index into names()
+        VariableDatabase::ValueType value;
+    };
+    
+    // Decodes the whole file up front so replay costs nothing but the
+    // writes. A torn record at the end (interrupted recording) is dropped.
+    bool open(const std::string& path);
+    void clear();
+    
+    const std::vector<std::string>& names() const { return names_; }
+    const std::vector<Event>& events() const { return events_; }
+    double duration() const { return events_.empty() ? 0.0 : events_.back().time * 1e-6; }
+    
+private:
+    std::vector<std::string> names_;
+    std::vector<Event> events_;
+};
+
+// Appends every write the database stores to a traffic log, through the
+// database's write hook. Owning thread only, like the database itself.
+class TrafficRecorder {
+public:
+    explicit TrafficRecorder(VariableDatabase& db);
+    ~TrafficRecorder();
+    TrafficRecorder(const TrafficRecorder&) = delete;
+    TrafficRecorder& operator=(const TrafficRecorder&) = delete;
+    
+    // Truncates the file, ending a recording in progress
+    bool start(const std::string& path);
+    void stop();
+    bool isRecording() const { return file_ != nullptr; }
+    
+    std::uint64_t eventCount() const { return events_; }
+    
+private:
+    void record(VariableId id, const VariableDatabase::ValueType& value);
+    void flush();
+    
+    VariableDatabase& db_;
+    Subscription hook_;
+    std::FILE* file_ = nullptr;
+    std::vector<std::uint8_t> buffer_;
+    static constexpr std::uint32_t UnnamedId = std::numeric_limits<std::uint32_t>::max();
+    
+    // Log id by database id, UnnamedId until first written
+    std::vector<std::uint32_t> logIds_;
+    std::uint32_t nextLogId_ = 0;
+    std::chrono::steady_clock::time_point start_;
+    std::uint64_t lastTime_ = 0;
+    std::uint64_t events_ = 0;
+};
+
+// Plays a traffic log into a database on a fixed clock: advance() moves
+// the replay position by a given amount of recording time and applies
+// everything up to it as one batch. The same sequence of advance() calls
+// always produces the same writes, whatever the wall-clock frame times.
+class TrafficReplayer {
+public:
+    explicit TrafficReplayer(const TrafficLog& log) : log_(log) {}
+    
+    // Resolves the log's variable names; call before advance()
+    void prepare(VariableDatabase& db);
+    std::size_t advance(VariableDatabase& db, double seconds);
+    void rewind();
+    
+    bool finished() const { return next_ >= log_.events().size(); }
+    double position() const { return clock_ * 1e-6; }
+    
+private:
+    const TrafficLog& log_;
+    std::vector<VariableId> ids_;
+    std::size_t next_ = 0;
+    std::uint64_t clock_ = 0;
+};
+
+} // namespace xsmall_hmi
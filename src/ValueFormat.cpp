@@ -0,0 +1,57 @@
+#include "ValueFormat.hpp"
+#include <charconv>
+#include <string_view>
+#include <type_traits>
+#include <variant>
+
+namespace xsmall_hmi {
+
+namespace {
+
+// Room for any double in fixed notation with a sane precision; values that
+// do not fit fall back to the general form
+constexpr std::size_t NumberBufferSize = 128;
+
+std::string_view writeNumber(char* first, char* last, double value, int precision) {
+    std::to_chars_result result = precision < 0
+        ? std::to_chars(first, last, value, std::chars_format::general, 6)
+        : std::to_chars(first, last, value, std::chars_format::fixed, precision);
+    if (result.ec != std::errc()) {
+        result = std::to_chars(first, last, value, std::chars_format::general, 6);
+    }
+    return std::string_view(first, static_cast<std::size_t>(result.ptr - first));
+}
+
+} // namespace
+
+bool formatValue(const VariableDatabase::ValueType& value, const FormatSpec& spec, std::string& text) {
+    char buffer[NumberBufferSize];
+    const std::string_view body = std::visit([&](const auto& v) -> std::string_view {
+        using T = std::decay_t<decltype(v)>;
+        if constexpr (std::is_same_v<T, std::string>) {
+            return v;
+        } else if constexpr (std::is_same_v<T, bool>) {
+            return v ? "true" : "false";
+        } else if constexpr (std::is_same_v<T, int>) {
+            if (spec.precision > 0) return writeNumber(buffer, buffer + sizeof(buffer), v, spec.precision);
+            return std::string_view(buffer, static_cast<std::size_t>(
+                std::to_chars(buffer, buffer + sizeof(buffer), v).ptr - buffer));
+        } else {
+            return writeNumber(buffer, buffer + sizeof(buffer), static_cast<double>(v), spec.precision);
+        }
+    }, value);
+    
+    const std::size_t size = spec.prefix.size() + body.size() + spec.suffix.size();
+    if (text.size() == size &&
+        text.compare(0, spec.prefix.size(), spec.prefix) == 0 &&
+        text.compare(spec.prefix.size(), body.size(), body) == 0 &&
+        text.compare(spec.prefix.size() + body.size(), spec.suffix.size(), spec.suffix) == 0) {
+        return false;
+    }
+    
+    // assign/append keep the string's capacity
+    text.assign(spec.prefix).append(body).append(spec.suffix);
+    return true;
+}
+
+} // namespace xsmall_hmi
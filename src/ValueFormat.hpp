@@ -0,0 +1,27 @@
+#pragma once
+#include <string>
+#include "VariableDatabase.hpp"
+
+namespace xsmall_hmi {
+
+// How a bound value is shown: prefix, the value, suffix (usually a unit,
+// e.g. " °C"). Numbers are written with std::to_chars.
+struct FormatSpec {
+    // Digits after the decimal point for numbers; negative keeps the
+    // shortest form with up to six significant digits (like "%g")
+    int precision = -1;
+    std::string prefix;
+    std::string suffix;
+    
+    bool operator==(const FormatSpec& other) const {
+        return precision == other.precision && prefix == other.prefix && suffix == other.suffix;
+    }
+    bool operator!=(const FormatSpec& other) const { return !(*this == other); }
+};
+
+// Writes value into text as the spec describes. Text is only touched when
+// the result differs, so an unchanged readout costs no allocation and no
+// text re-layout; returns whether it changed.
+bool formatValue(const VariableDatabase::ValueType& value, const FormatSpec& spec, std::string& text);
+
+} // namespace xsmall_hmi
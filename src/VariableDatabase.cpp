@@ -1,36 +1,464 @@
 #include "VariableDatabase.hpp"
+#include "ProfilerCounters.hpp"
+#include <algorithm>
+#include <cmath>
+#include <type_traits>
 
 namespace xsmall_hmi {
 
-void VariableDatabase::setVariable(const std::string& name, const ValueType& value) {
-    variables_[name] = value;
-    
-    auto range = callbacks_.equal_range(name);
-    for (auto it = range.first; it != range.second; ++it) {
-        it->second(name, value);
+namespace {
+
+std::optional<double> numericValue(const VariableDatabase::ValueType& value) {
+    return std::visit([](const auto& v) -> std::optional<double> {
+        using T = std::decay_t<decltype(v)>;
+        if constexpr (std::is_same_v<T, bool> || std::is_same_v<T, std::string>) {
+            return std::nullopt;
+        } else {
+            return static_cast<double>(v);
+        }
+    }, value);
+}
+
+std::size_t roundUpPowerOfTwo(std::size_t value) {
+    std::size_t rounded = 2;
+    while (rounded < value) rounded <<= 1;
+    return rounded;
+}
+
+bool hasValueFilter(const SubscribeOptions& options) {
+    return options.deadband != SubscribeOptions::Deadband::None || options.skipUnchanged;
+}
+
+} // namespace
+
+VariableDatabase::VariableDatabase(std::size_t publishCapacity)
+    : publishMask_(roundUpPowerOfTwo(publishCapacity) - 1),
+      publishCells_(std::make_unique<PublishCell[]>(publishMask_ + 1)) {
+    for (std::size_t i = 0; i <= publishMask_; ++i) {
+        publishCells_[i].sequence.store(i, std::memory_order_relaxed);
     }
 }
 
+VariableDatabase::~VariableDatabase() = default;
+
+void VariableDatabase::setVariable(const std::string& name, const ValueType& value) {
+    setVariable(resolveId(name), value);
+}
+
 std::optional<VariableDatabase::ValueType> 
 VariableDatabase::getVariable(const std::string& name) const {
-    auto it = variables_.find(name);
-    if (it != variables_.end()) {
+    return getVariable(findId(name));
+}
+
+bool VariableDatabase::hasVariable(const std::string& name) const {
+    return hasVariable(findId(name));
+}
+
+void VariableDatabase::removeVariable(const std::string& name) {
+    VariableId id = findId(name);
+    if (id == InvalidVariableId) return;
+    
+    // Subscriptions belong to their tokens and fire again once the
+    // variable is set anew
+    Slot& slot = slots_[id];
+    slot.present = false;
+    slot.value = ValueType{};
+    slot.notifyPending = false;
+}
+
+Subscription VariableDatabase::subscribe(const std::string& name, Callback callback,
+                                         const SubscribeOptions& options) {
+    return subscribe(resolveId(name), std::move(callback), options);
+}
+
+VariableId VariableDatabase::resolveId(const std::string& name) {
+    auto it = ids_.find(name);
+    if (it != ids_.end()) {
         return it->second;
     }
+    
+    VariableId id = static_cast<VariableId>(slots_.size());
+    slots_.emplace_back();
+    slots_.back().name = name;
+    ids_.emplace(name, id);
+    return id;
+}
+
+VariableId VariableDatabase::findId(const std::string& name) const {
+    auto it = ids_.find(name);
+    return it != ids_.end() ? it->second : InvalidVariableId;
+}
+
+const std::string& VariableDatabase::getName(VariableId id) const {
+    static const std::string empty;
+    return id < slots_.size() ? slots_[id].name : empty;
+}
+
+void VariableDatabase::setVariable(VariableId id, const ValueType& value) {
+    // The clock is read only if a hook will see the time
+    setVariable(id, value, writeHooks_.empty() ? 0.0 : now());
+}
+
+void VariableDatabase::setVariable(VariableId id, const ValueType& value, double time) {
+    if (id >= slots_.size()) return;
+    
+    slots_[id].value = value;
+    afterWrite(id, time);
+}
+
+void VariableDatabase::afterWrite(VariableId id, double time) {
+    Slot& slot = slots_[id];
+    slot.present = true;
+    
+    for (const auto& hook : writeHooks_) {
+        hook.second(id, slot.value, time);
+    }
+    
+    if (slot.subscribers.empty()) return;
+    
+    if (batchDepth_ > 0 || notificationMode_ == NotificationMode::Deferred) {
+        if (!slot.notifyPending) {
+            slot.notifyPending = true;
+            pendingNotifications_.push_back(id);
+        }
+        return;
+    }
+    
+    notify(id);
+}
+
+std::size_t VariableDatabase::notify(VariableId id, bool heldOnly) {
+    // Callbacks may subscribe, unsubscribe or intern names. Slots never move,
+    // so the slot's name and value stay valid while callbacks run.
+    // Subscribers added meanwhile wait for the next change; removed ones are
+    // only marked until the outermost notify() is done.
+    Slot& slot = slots_[id];
+    const std::size_t count = slot.subscribers.size();
+    std::optional<double> number;
+    if (slot.filtered) {
+        number = numericValue(slot.value);
+    }
+    // Filters run before any callback, and the clock is read only if a
+    // rate limit needs it
+    std::optional<Clock::time_point> now;
+    std::size_t fired = 0;
+    
+    ++notifying_;
+    for (std::size_t i = 0; i < count; ++i) {
+        Subscriber& subscriber = slot.subscribers[i];
+        if (subscriber.removed || (heldOnly && !subscriber.held)) continue;
+        
+        if (slot.filtered) {
+            const SubscribeOptions& options = subscriber.options;
+            if (!passesValueFilter(subscriber, slot.value, number)) {
+                // Back within the filter of what was last delivered
+                subscriber.held = false;
+                continue;
+            }
+            if (options.maxRate > 0) {
+                if (!now) now = Clock::now();
+                if (subscriber.notified &&
+                    *now - subscriber.lastTime < std::chrono::duration<double>(1.0 / options.maxRate)) {
+                    subscriber.held = true;
+                    if (!slot.held) {
+                        slot.held = true;
+                        heldSlots_.push_back(id);
+                    }
+                    continue;
+                }
+                subscriber.lastTime = *now;
+            }
+            
+            subscriber.held = false;
+            subscriber.notified = true;
+            if (hasValueFilter(options)) {
+                subscriber.lastNumeric = number.has_value();
+                if (number) {
+                    subscriber.lastNumber = *number;
+                } else {
+                    subscriber.lastValue = slot.value;
+                }
+            }
+        }
+        subscriber.callback(slot.name, slot.value);
+        ++fired;
+    }
+    if (--notifying_ == 0 && (!compactSlots_.empty() || !addedSubscribers_.empty())) {
+        settleSubscribers();
+    }
+    
+    ProfilerCounters::count(ProfilerCounters::Counter::CallbacksFired, fired);
+    return fired;
+}
+
+bool VariableDatabase::passesValueFilter(const Subscriber& subscriber, const ValueType& value,
+                                         const std::optional<double>& number) {
+    const SubscribeOptions& options = subscriber.options;
+    if (!subscriber.notified || !hasValueFilter(options)) return true;
+    
+    // A switch between a number and a string or bool is always a change
+    if (number.has_value() != subscriber.lastNumeric) return true;
+    if (!number) return value != subscriber.lastValue;
+    
+    const double delta = std::abs(*number - subscriber.lastNumber);
+    switch (options.deadband) {
+        case SubscribeOptions::Deadband::Absolute:
+            return delta > options.deadbandValue;
+        case SubscribeOptions::Deadband::Percent:
+            return delta > std::abs(subscriber.lastNumber) * options.deadbandValue / 100.0;
+        case SubscribeOptions::Deadband::None:
+            break;
+    }
+    return delta != 0.0;
+}
+
+std::size_t VariableDatabase::releaseHeld() {
+    // Subscribers still inside their interval are held again
+    releasing_.swap(heldSlots_);
+    
+    std::size_t released = 0;
+    for (VariableId id : releasing_) {
+        Slot& slot = slots_[id];
+        slot.held = false;
+        if (slot.present && notify(id, true) > 0) {
+            ++released;
+        }
+    }
+    releasing_.clear();
+    return released;
+}
+
+std::optional<VariableDatabase::ValueType> VariableDatabase::getVariable(VariableId id) const {
+    if (const ValueType* value = findValue(id)) {
+        return *value;
+    }
     return std::nullopt;
 }
 
-bool VariableDatabase::hasVariable(const std::string& name) const {
-    return variables_.find(name) != variables_.end();
+const VariableDatabase::ValueType* VariableDatabase::findValue(VariableId id) const {
+    if (id < slots_.size() && slots_[id].present) {
+        return &slots_[id].value;
+    }
+    return nullptr;
 }
 
-void VariableDatabase::removeVariable(const std::string& name) {
-    variables_.erase(name);
-    callbacks_.erase(name);
+bool VariableDatabase::hasVariable(VariableId id) const {
+    return findValue(id) != nullptr;
+}
+
+Subscription VariableDatabase::subscribe(VariableId id, Callback callback,
+                                         const SubscribeOptions& options) {
+    if (id >= slots_.size() || !callback) return Subscription();
+    
+    Subscriber subscriber;
+    subscriber.callback = std::move(callback);
+    subscriber.key = nextSubscriberKey_++;
+    subscriber.options = options;
+    const std::uint32_t key = subscriber.key;
+    
+    if (notifying_ > 0) {
+        // Growing a subscriber list would move the callback that is running
+        addedSubscribers_.emplace_back(id, std::move(subscriber));
+        return Subscription(this, id, key);
+    }
+    Slot& slot = slots_[id];
+    slot.subscribers.push_back(std::move(subscriber));
+    slot.filtered = slot.filtered || hasValueFilter(options) || options.maxRate > 0;
+    return Subscription(this, id, key);
+}
+
+std::size_t VariableDatabase::subscriberCount(VariableId id) const {
+    if (id >= slots_.size()) return 0;
+    const auto& subscribers = slots_[id].subscribers;
+    auto count = std::count_if(subscribers.begin(), subscribers.end(),
+                               [](const Subscriber& s) { return !s.removed; });
+    count += std::count_if(addedSubscribers_.begin(), addedSubscribers_.end(),
+                           [id](const auto& added) { return added.first == id; });
+    return static_cast<std::size_t>(count);
+}
+
+void VariableDatabase::unsubscribe(VariableId id, std::uint32_t key) {
+    if (id == InvalidVariableId) {
+        auto hook = std::find_if(writeHooks_.begin(), writeHooks_.end(),
+                                 [key](const auto& h) { return h.first == key; });
+        if (hook != writeHooks_.end()) writeHooks_.erase(hook);
+        return;
+    }
+    
+    Slot& slot = slots_[id];
+    auto it = std::find_if(slot.subscribers.begin(), slot.subscribers.end(),
+                           [key](const Subscriber& s) { return s.key == key; });
+    if (it == slot.subscribers.end()) {
+        // Not merged yet, so it cannot be running
+        auto added = std::find_if(addedSubscribers_.begin(), addedSubscribers_.end(),
+                                  [key](const auto& a) { return a.second.key == key; });
+        if (added != addedSubscribers_.end()) addedSubscribers_.erase(added);
+        return;
+    }
+    
+    if (notifying_ > 0) {
+        // The callback may be the one running; it is destroyed afterwards
+        if (!it->removed) {
+            it->removed = true;
+            compactSlots_.push_back(id);
+        }
+        return;
+    }
+    slot.subscribers.erase(it);
+    updateFiltered(slot);
+}
+
+void VariableDatabase::updateFiltered(Slot& slot) {
+    slot.filtered = std::any_of(slot.subscribers.begin(), slot.subscribers.end(), [](const Subscriber& s) {
+        return hasValueFilter(s.options) || s.options.maxRate > 0;
+    });
+}
+
+void VariableDatabase::settleSubscribers() {
+    for (VariableId id : compactSlots_) {
+        auto& subscribers = slots_[id].subscribers;
+        subscribers.erase(std::remove_if(subscribers.begin(), subscribers.end(),
+                                         [](const Subscriber& s) { return s.removed; }),
+                          subscribers.end());
+        updateFiltered(slots_[id]);
+    }
+    compactSlots_.clear();
+    
+    for (auto& [id, subscriber] : addedSubscribers_) {
+        Slot& slot = slots_[id];
+        slot.filtered = slot.filtered || hasValueFilter(subscriber.options) || subscriber.options.maxRate > 0;
+        slot.subscribers.push_back(std::move(subscriber));
+    }
+    addedSubscribers_.clear();
+}
+
+Subscription::Subscription(Subscription&& other) noexcept
+    : db_(other.db_), id_(other.id_), key_(other.key_) {
+    other.db_ = nullptr;
+}
+
+Subscription& Subscription::operator=(Subscription&& other) noexcept {
+    if (this != &other) {
+        reset();
+        db_ = other.db_;
+        id_ = other.id_;
+        key_ = other.key_;
+        other.db_ = nullptr;
+    }
+    return *this;
+}
+
+void Subscription::reset() {
+    if (db_) {
+        db_->unsubscribe(id_, key_);
+        db_ = nullptr;
+    }
+}
+
+Subscription VariableDatabase::addWriteHook(WriteHook hook) {
+    const std::uint32_t key = nextSubscriberKey_++;
+    writeHooks_.emplace_back(key, std::move(hook));
+    return Subscription(this, InvalidVariableId, key);
+}
+
+double VariableDatabase::now() {
+    auto sinceEpoch = std::chrono::system_clock::now().time_since_epoch();
+    return std::chrono::duration<double>(sinceEpoch).count();
+}
+
+void VariableDatabase::beginBatch() {
+    ++batchDepth_;
+}
+
+void VariableDatabase::commitBatch() {
+    if (batchDepth_ == 0) return;
+    
+    if (--batchDepth_ == 0 && notificationMode_ == NotificationMode::Immediate) {
+        dispatchNotifications();
+    }
+}
+
+void VariableDatabase::setVariables(const std::vector<std::pair<VariableId, ValueType>>& values) {
+    beginBatch();
+    for (const auto& [id, value] : values) {
+        setVariable(id, value);
+    }
+    commitBatch();
+}
+
+void VariableDatabase::setNotificationMode(NotificationMode mode) {
+    notificationMode_ = mode;
+    if (mode == NotificationMode::Immediate && batchDepth_ == 0) {
+        dispatchNotifications();
+    }
+}
+
+std::size_t VariableDatabase::dispatchNotifications() {
+    // Writes made by callbacks queue up again for the next dispatch
+    dispatching_.swap(pendingNotifications_);
+    
+    std::size_t dispatched = 0;
+    for (VariableId id : dispatching_) {
+        Slot& slot = slots_[id];
+        if (!slot.notifyPending) continue;
+        
+        slot.notifyPending = false;
+        if (slot.present && notify(id) > 0) {
+            ++dispatched;
+        }
+    }
+    dispatching_.clear();
+    return dispatched + releaseHeld();
+}
+
+bool VariableDatabase::publish(VariableId id, ValueType value) {
+    std::size_t position = publishEnqueue_.load(std::memory_order_relaxed);
+    for (;;) {
+        PublishCell& cell = publishCells_[position & publishMask_];
+        const std::size_t sequence = cell.sequence.load(std::memory_order_acquire);
+        const auto lag = static_cast<std::ptrdiff_t>(sequence - position);
+        if (lag == 0) {
+            if (publishEnqueue_.compare_exchange_weak(position, position + 1,
+                                                      std::memory_order_relaxed)) {
+                cell.id = id;
+                cell.value = std::move(value);
+                cell.sequence.store(position + 1, std::memory_order_release);
+                return true;
+            }
+        } else if (lag < 0) {
+            // The cell still holds a value from one lap ago: full
+            return false;
+        } else {
+            position = publishEnqueue_.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+std::size_t VariableDatabase::applyPublished() {
+    // At most one lap, so producers that never pause cannot keep the owning
+    // thread here
+    std::size_t applied = 0;
+    beginBatch();
+    while (applied <= publishMask_) {
+        PublishCell& cell = publishCells_[publishDequeue_ & publishMask_];
+        if (cell.sequence.load(std::memory_order_acquire) != publishDequeue_ + 1) break;
+        
+        if (cell.id < slots_.size()) {
+            slots_[cell.id].value = std::move(cell.value);
+            afterWrite(cell.id, writeHooks_.empty() ? 0.0 : now());
+        }
+        // Free for the producer one lap ahead
+        cell.sequence.store(publishDequeue_ + publishMask_ + 1, std::memory_order_release);
+        ++publishDequeue_;
+        ++applied;
+    }
+    commitBatch();
+    return applied;
 }
 
-void VariableDatabase::subscribe(const std::string& name, Callback callback) {
-    callbacks_.emplace(name, std::move(callback));
+bool VariableDatabase::hasPublished() const {
+    const PublishCell& cell = publishCells_[publishDequeue_ & publishMask_];
+    return cell.sequence.load(std::memory_order_acquire) == publishDequeue_ + 1;
 }
 
-} // namespace xsmall_hmi
\ No newline at end of file
+} // namespace xsmall_hmi
@@ -5,15 +5,88 @@
 #include <optional>
 #include <variant>
 #include <functional>
+#include <vector>
+#include <deque>
+#include <cstdint>
+#include <limits>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include "SmallFunction.hpp"
 
 namespace xsmall_hmi {
 
+// Dense handle of an interned variable name. Stays valid for the lifetime of
+// the database, even across removeVariable().
+using VariableId = std::uint32_t;
+inline constexpr VariableId InvalidVariableId = std::numeric_limits<VariableId>::max();
+
+// Per-subscriber filter, applied inside the database before the callback is
+// called. Comparisons are against the value this subscriber was last
+// notified with; its first notification always passes.
+struct SubscribeOptions {
+    enum class Deadband {
+        None,
+        Absolute,   // numbers must move by more than deadbandValue
+        Percent     // ... by more than deadbandValue % of the last value
+    };
+    
+    // Non-numeric values pass a deadband whenever they change
+    Deadband deadband = Deadband::None;
+    double deadbandValue = 0.0;
+    // Writes that store the value already notified are skipped
+    bool skipUnchanged = false;
+    // Notifications per second, 0 for unlimited. A value held back by the
+    // limit is delivered by a later dispatchNotifications() once the
+    // subscriber's interval has passed, so the last value is never lost.
+    double maxRate = 0.0;
+};
+
+class VariableDatabase;
+
+// Registration returned by subscribe() and addWriteHook(); destroying or
+// resetting it removes the callback. Must not outlive its database.
+class [[nodiscard]] Subscription {
+public:
+    Subscription() = default;
+    Subscription(Subscription&& other) noexcept;
+    Subscription& operator=(Subscription&& other) noexcept;
+    Subscription(const Subscription&) = delete;
+    Subscription& operator=(const Subscription&) = delete;
+    ~Subscription() { reset(); }
+    
+    void reset();
+    bool isActive() const { return db_ != nullptr; }
+    
+private:
+    friend class VariableDatabase;
+    Subscription(VariableDatabase* db, VariableId id, std::uint32_t key)
+        : db_(db), id_(id), key_(key) {}
+    
+    VariableDatabase* db_ = nullptr;
+    VariableId id_ = InvalidVariableId;
+    std::uint32_t key_ = 0;
+};
+
 class VariableDatabase {
 public:
     using ValueType = std::variant<int, float, double, bool, std::string>;
-    using Callback = std::function<void(const std::string&, const ValueType&)>;
+    // Captures of up to four pointers are stored without allocating
+    using Callback = SmallFunction<void(const std::string&, const ValueType&)>;
+    // Sees every stored write, including batched and published ones, with
+    // the wall-clock time the value was produced (see now())
+    using WriteHook = std::function<void(VariableId, const ValueType&, double time)>;
     
-    VariableDatabase() = default;
+    enum class NotificationMode {
+        Immediate,  // subscribers run inside setVariable (outside of batches)
+        Deferred    // subscribers run in dispatchNotifications()
+    };
+    
+    // publishCapacity bounds the values published and not yet applied
+    explicit VariableDatabase(std::size_t publishCapacity = 4096);
+    ~VariableDatabase();
+    VariableDatabase(const VariableDatabase&) = delete;
+    VariableDatabase& operator=(const VariableDatabase&) = delete;
     
     void setVariable(const std::string& name, const ValueType& value);
     std::optional<ValueType> getVariable(const std::string& name) const;
@@ -21,25 +94,159 @@ public:
     bool hasVariable(const std::string& name) const;
     void removeVariable(const std::string& name);
     
-    void subscribe(const std::string& name, Callback callback);
+    // The callback stays registered as long as the returned token lives
+    Subscription subscribe(const std::string& name, Callback callback, const SubscribeOptions& options = {});
     
     template<typename T>
     std::optional<T> getVariableAs(const std::string& name) const;
-
+    
+    // Handle API: resolve a name once, then get/set through index-based storage
+    VariableId resolveId(const std::string& name);
+    VariableId findId(const std::string& name) const;
+    const std::string& getName(VariableId id) const;
+    
+    void setVariable(VariableId id, const ValueType& value);
+    // Write stamped by its source; write hooks get time instead of the time
+    // of the call
+    void setVariable(VariableId id, const ValueType& value, double time);
+    std::optional<ValueType> getVariable(VariableId id) const;
+    const ValueType* findValue(VariableId id) const;
+    bool hasVariable(VariableId id) const;
+    Subscription subscribe(VariableId id, Callback callback, const SubscribeOptions& options = {});
+    std::size_t subscriberCount(VariableId id) const;
+    
+    template<typename T>
+    std::optional<T> getVariableAs(VariableId id) const;
+    
+    // Batched writes: values are applied at once, and each subscriber is
+    // notified at most once per commit with the latest value. Batches nest.
+    void beginBatch();
+    void commitBatch();
+    void setVariables(const std::vector<std::pair<VariableId, ValueType>>& values);
+    
+    // In Deferred mode notifications accumulate until the owner drains them,
+    // typically once per frame. Rate-limited values held back earlier are
+    // delivered here too, in either mode.
+    void setNotificationMode(NotificationMode mode);
+    NotificationMode getNotificationMode() const { return notificationMode_; }
+    std::size_t dispatchNotifications();
+    // Notifications a later dispatchNotifications() would deliver: deferred
+    // ones, or values held back by a rate limit
+    bool hasPendingNotifications() const { return !pendingNotifications_.empty() || !heldSlots_.empty(); }
+    
+    // Concurrent mode: publish() may be called from any thread; it never
+    // blocks or allocates, and returns false (dropping the value) while
+    // publishCapacity values wait to be applied. Published values become
+    // visible (and subscribers are notified) only when the owning thread
+    // calls applyPublished(), so everything the owning thread reads between
+    // two calls is one consistent snapshot.
+    // Ids must be resolved on the owning thread before producers start.
+    // Write hooks see published values stamped with the time they are applied.
+    bool publish(VariableId id, ValueType value);
+    std::size_t applyPublished();
+    // Owning thread only: whether applyPublished() has anything to apply
+    bool hasPublished() const;
+    
+    // The hook stays installed as long as the returned token lives. Hooks
+    // must not add or remove hooks themselves.
+    Subscription addWriteHook(WriteHook hook);
+    bool hasWriteHook() const { return !writeHooks_.empty(); }
+    
+    // Wall-clock seconds, the time base of write timestamps
+    static double now();
+    
 private:
-    std::unordered_map<std::string, ValueType> variables_;
-    std::unordered_multimap<std::string, Callback> callbacks_;
+    using Clock = std::chrono::steady_clock;
+    
+    struct Subscriber {
+        Callback callback;
+        std::uint32_t key = 0;
+        bool removed = false;  // unsubscribed while its slot was notifying
+        SubscribeOptions options;
+        // Last delivered value, kept only for value filters: numbers as a
+        // double, strings and bools as they are
+        ValueType lastValue;
+        double lastNumber = 0.0;
+        bool lastNumeric = false;
+        Clock::time_point lastTime;
+        bool notified = false;
+        bool held = false;  // passed the value filter, waiting for the rate limit
+    };
+    
+    struct Slot {
+        std::string name;
+        ValueType value;
+        bool present = false;
+        bool notifyPending = false;
+        bool filtered = false;  // some subscriber has options
+        bool held = false;      // listed in heldSlots_
+        std::vector<Subscriber> subscribers;
+    };
+    
+    // Cell of the bounded multi-producer queue (Vyukov). sequence == position
+    // means free for the producer claiming that position, position + 1 means
+    // filled and ready for the consumer.
+    struct PublishCell {
+        std::atomic<std::size_t> sequence{0};
+        VariableId id = InvalidVariableId;
+        ValueType value;
+    };
+    
+    static constexpr std::size_t CacheLine = 64;
+    
+    friend class Subscription;
+    // An invalid id removes the write hook with that key
+    void unsubscribe(VariableId id, std::uint32_t key);
+    // After the outermost notify(): erases subscribers removed and adds
+    // those subscribed while callbacks were running
+    void settleSubscribers();
+    void updateFiltered(Slot& slot);
+    
+    // Writes hooks and notifications owe for the value just stored in the slot
+    void afterWrite(VariableId id, double time);
+    // Returns the number of callbacks called; heldOnly retries only
+    // subscribers held back by their rate limit
+    std::size_t notify(VariableId id, bool heldOnly = false);
+    static bool passesValueFilter(const Subscriber& subscriber, const ValueType& value,
+                                  const std::optional<double>& number);
+    std::size_t releaseHeld();
+    
+    std::unordered_map<std::string, VariableId> ids_;
+    // A deque so that interning a name inside a callback does not move the
+    // slot whose name and value the callback was given
+    std::deque<Slot> slots_;
+    
+    NotificationMode notificationMode_ = NotificationMode::Immediate;
+    int batchDepth_ = 0;
+    std::vector<VariableId> pendingNotifications_;
+    std::vector<VariableId> dispatching_;
+    std::vector<VariableId> heldSlots_;
+    std::vector<VariableId> releasing_;
+    std::uint32_t nextSubscriberKey_ = 1;
+    int notifying_ = 0;
+    std::vector<VariableId> compactSlots_;
+    std::vector<std::pair<VariableId, Subscriber>> addedSubscribers_;
+    std::vector<std::pair<std::uint32_t, WriteHook>> writeHooks_;
+    
+    const std::size_t publishMask_;
+    std::unique_ptr<PublishCell[]> publishCells_;
+    alignas(CacheLine) std::atomic<std::size_t> publishEnqueue_{0};
+    alignas(CacheLine) std::size_t publishDequeue_ = 0;  // owning thread only
 };
 
 template<typename T>
 std::optional<T> VariableDatabase::getVariableAs(const std::string& name) const {
-    auto it = variables_.find(name);
-    if (it != variables_.end()) {
-        if (auto* value = std::get_if<T>(&it->second)) {
-            return *value;
+    return getVariableAs<T>(findId(name));
+}
+
+template<typename T>
+std::optional<T> VariableDatabase::getVariableAs(VariableId id) const {
+    if (const ValueType* value = findValue(id)) {
+        if (auto* typed = std::get_if<T>(value)) {
+            return *typed;
         }
     }
     return std::nullopt;
 }
 
-} // namespace xsmall_hmi
\ No newline at end of file
+} // namespace xsmall_hmi
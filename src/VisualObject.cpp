@@ -1,22 +1,200 @@
 #include "VisualObject.hpp"
 #include "VariableDatabase.hpp"
+#include "ResourceCache.hpp"
+#include "SceneStore.hpp"
+#include "SpatialIndex.hpp"
+#include "BindingTracker.hpp"
+#include "Historian.hpp"
+#include "ProfilerCounters.hpp"
+#include <algorithm>
+#include <cmath>
 #include <iostream>
+#include <type_traits>
+#include <variant>
 
 namespace xsmall_hmi {
 
+namespace {
+
+bool nearSegment(const sf::Vector2f& point, const sf::Vector2f& start, const sf::Vector2f& end,
+                 float distance) {
+    const sf::Vector2f segment = end - start;
+    const float lengthSquared = segment.lengthSquared();
+    float t = 0.0f;
+    if (lengthSquared > 0.0f) {
+        t = std::clamp((point - start).dot(segment) / lengthSquared, 0.0f, 1.0f);
+    }
+    const sf::Vector2f offset = point - (start + segment * t);
+    return offset.lengthSquared() <= distance * distance;
+}
+
+std::optional<double> toNumber(const VariableDatabase::ValueType& value) {
+    return std::visit([](const auto& v) -> std::optional<double> {
+        using T = std::decay_t<decltype(v)>;
+        if constexpr (std::is_same_v<T, std::string>) {
+            return std::nullopt;
+        } else {
+            return static_cast<double>(v);
+        }
+    }, value);
+}
+
+void appendQuad(std::vector<sf::Vertex>& triangles, const sf::Vector2f& pos,
+                const sf::Vector2f& size, const sf::Color& color) {
+    sf::Vector2f topRight(pos.x + size.x, pos.y);
+    sf::Vector2f bottomRight = pos + size;
+    sf::Vector2f bottomLeft(pos.x, pos.y + size.y);
+    
+    triangles.push_back(sf::Vertex{pos, color});
+    triangles.push_back(sf::Vertex{topRight, color});
+    triangles.push_back(sf::Vertex{bottomRight, color});
+    triangles.push_back(sf::Vertex{pos, color});
+    triangles.push_back(sf::Vertex{bottomRight, color});
+    triangles.push_back(sf::Vertex{bottomLeft, color});
+}
+
+// Same result as sf::RectangleShape with a positive outline thickness
+void appendOutlinedRect(std::vector<sf::Vertex>& triangles, const sf::Vector2f& pos,
+                        const sf::Vector2f& size, const sf::Color& fill,
+                        const sf::Color& outline, float thickness) {
+    appendQuad(triangles, pos, size, fill);
+    appendQuad(triangles, sf::Vector2f(pos.x - thickness, pos.y - thickness),
+               sf::Vector2f(size.x + 2 * thickness, thickness), outline);
+    appendQuad(triangles, sf::Vector2f(pos.x - thickness, pos.y + size.y),
+               sf::Vector2f(size.x + 2 * thickness, thickness), outline);
+    appendQuad(triangles, sf::Vector2f(pos.x - thickness, pos.y),
+               sf::Vector2f(thickness, size.y), outline);
+    appendQuad(triangles, sf::Vector2f(pos.x + size.x, pos.y),
+               sf::Vector2f(thickness, size.y), outline);
+}
+
+} // namespace
+
+void CachedText::set(const sf::Font& font, const std::string& string, unsigned int characterSize,
+                     const sf::Vector2f& position, const sf::Color& color) {
+    if (!text_) {
+        text_.emplace(font, string, characterSize);
+        text_->setPosition(position);
+        text_->setFillColor(color);
+        string_ = string;
+        return;
+    }
+    
+    // sf::Text invalidates its layout on every setter, so only call changed ones
+    if (string != string_) {
+        text_->setString(string);
+        string_ = string;
+    }
+    if (text_->getCharacterSize() != characterSize) {
+        text_->setCharacterSize(characterSize);
+    }
+    if (text_->getPosition() != position) {
+        text_->setPosition(position);
+    }
+    if (text_->getFillColor() != color) {
+        text_->setFillColor(color);
+    }
+}
+
+void CachedText::draw(sf::RenderTarget& target) const {
+    if (text_ && !string_.empty()) {
+        target.draw(*text_);
+        ProfilerCounters::count(ProfilerCounters::Counter::DrawCalls);
+    }
+}
+
+sf::FloatRect CachedText::bounds() const {
+    return text_ ? text_->getGlobalBounds() : sf::FloatRect();
+}
+
 VisualObject::VisualObject(ObjectType type, const std::string& id)
     : type_(type), id_(id), position_(0, 0), size_(100, 50), 
-      color_(sf::Color::White) {
+      color_(sf::Color::White),
+      font_(ResourceCache::instance().getFont("arial.ttf")) {
+}
+
+VisualObject::~VisualObject() {
+    if (tracker_) {
+        tracker_->untrack(this);
+    }
+    if (spatialIndex_) {
+        spatialIndex_->remove(this);
+    }
+}
+
+void VisualObject::setUpdatePending(bool pending) {
+    updatePending_ = pending;
+    if (store_) {
+        store_->syncUpdatePending(*this);
+    }
+}
+
+void VisualObject::invalidateGeometry() {
+    ++geometryVersion_;
+    if (store_) {
+        store_->syncGeometryVersion(*this);
+    }
+}
+
+void VisualObject::invalidateBounds() {
+    onBoundsChanged();
+    invalidateGeometry();
+    if (store_) {
+        store_->syncBounds(*this);
+    }
+    if (spatialIndex_) {
+        spatialIndex_->update(this);
+    }
+}
+
+void VisualObject::draw(sf::RenderTarget& target) const {
+    std::vector<sf::Vertex> triangles;
+    std::vector<sf::Vertex> lines;
+    appendGeometry(triangles, lines);
+    
+    if (!triangles.empty()) {
+        target.draw(triangles.data(), triangles.size(), sf::PrimitiveType::Triangles);
+    }
+    if (!lines.empty()) {
+        target.draw(lines.data(), lines.size(), sf::PrimitiveType::Lines);
+    }
     
-    if (!font_.openFromFile("arial.ttf")) {
+    std::vector<sf::Vertex> textured;
+    if (const sf::Texture* texture = appendTexturedGeometry(textured)) {
+        target.draw(textured.data(), textured.size(), sf::PrimitiveType::Triangles,
+                    sf::RenderStates(texture));
     }
+    drawOverlay(target);
 }
 
 void VisualObject::update(const VariableDatabase& db) {
-    if (!boundVariable_.empty()) {
-        if (auto value = db.getVariableAs<std::string>(boundVariable_)) {
-            text_ = *value;
-        }
+    if (auto value = evaluateBinding(db)) {
+        if (formatValue(*value, format_, text_)) invalidateGeometry();
+    }
+}
+
+std::optional<VariableDatabase::ValueType> VisualObject::evaluateBinding(const VariableDatabase& db) {
+    // Bindings set without a database compile on first use, once every
+    // variable they read exists; ids never move after that
+    if (!binding_.isCompiled() && !boundVariable_.empty() && binding_.error().empty()) {
+        if (binding_.compileExisting(boundVariable_, db) && store_) store_->syncBinding(*this);
+        reportBindingError();
+    }
+    return binding_.evaluate(db);
+}
+
+const std::vector<VariableId>& VisualObject::resolveBinding(VariableDatabase& db) {
+    if (!binding_.isCompiled() && !boundVariable_.empty() && binding_.error().empty()) {
+        if (binding_.compile(boundVariable_, db) && store_) store_->syncBinding(*this);
+        reportBindingError();
+    }
+    return binding_.inputs();
+}
+
+void VisualObject::reportBindingError() const {
+    if (!binding_.error().empty()) {
+        std::cerr << "Invalid binding \"" << boundVariable_ << "\" on " << id_ << ": "
+                  << binding_.error() << std::endl;
     }
 }
 
@@ -24,29 +202,75 @@ bool VisualObject::contains(const sf::Vector2f& point) const {
     return getBounds().contains(point);
 }
 
-void VisualObject::setPosition(const sf::Vector2f& pos) { position_ = pos; }
-void VisualObject::setSize(const sf::Vector2f& sz) { size_ = sz; }
-void VisualObject::setColor(const sf::Color& color) { color_ = color; }
-void VisualObject::setText(const std::string& text) { text_ = text; }
-void VisualObject::setVariableBinding(const std::string& varName) { boundVariable_ = varName; }
+void VisualObject::setPosition(const sf::Vector2f& pos) {
+    position_ = pos;
+    invalidateBounds();
+}
+
+void VisualObject::setSize(const sf::Vector2f& sz) {
+    size_ = sz;
+    invalidateBounds();
+}
+
+void VisualObject::setColor(const sf::Color& color) {
+    color_ = color;
+    if (store_) store_->syncColor(*this);
+    invalidateGeometry();
+}
+
+void VisualObject::setText(const std::string& text) {
+    if (text == text_) return;
+    text_ = text;
+    invalidateGeometry();
+}
+
+void VisualObject::setFormat(const FormatSpec& format) {
+    format_ = format;
+}
+
+void VisualObject::setVariableBinding(const std::string& binding) {
+    boundVariable_ = binding;
+    binding_.clear();
+    if (store_) store_->syncBinding(*this);
+}
+
+void VisualObject::setVariableBinding(VariableDatabase& db, const std::string& binding) {
+    boundVariable_ = binding;
+    binding_.clear();
+    resolveBinding(db);
+    if (store_) store_->syncBinding(*this);
+}
 
 sf::FloatRect VisualObject::getBounds() const {
     return sf::FloatRect(position_, size_);
 }
 
+sf::FloatRect VisualObject::getDrawBounds() const {
+    // Covers the 2px outline every filled object gets
+    const sf::Vector2f outline(2.0f, 2.0f);
+    return sf::FloatRect(position_ - outline, size_ + outline + outline);
+}
+
+sf::FloatRect VisualObject::drawBoundsWith(const CachedText& label) const {
+    const sf::FloatRect own = VisualObject::getDrawBounds();
+    const sf::FloatRect text = label.bounds();
+    if (text.size.x <= 0 || text.size.y <= 0) return own;
+    
+    const sf::Vector2f topLeft(std::min(own.position.x, text.position.x),
+                               std::min(own.position.y, text.position.y));
+    const sf::Vector2f bottomRight(std::max(own.position.x + own.size.x, text.position.x + text.size.x),
+                                   std::max(own.position.y + own.size.y, text.position.y + text.size.y));
+    return sf::FloatRect(topLeft, bottomRight - topLeft);
+}
+
 RectangleObject::RectangleObject(const std::string& id)
     : VisualObject(ObjectType::Rectangle, id) {
     color_ = sf::Color(200, 200, 200);
 }
 
-void RectangleObject::draw(sf::RenderWindow& window) const {
-    sf::RectangleShape shape;
-    shape.setPosition(position_);
-    shape.setSize(size_);
-    shape.setFillColor(color_);
-    shape.setOutlineColor(sf::Color::Black);
-    shape.setOutlineThickness(2.0f);
-    window.draw(shape);
+void RectangleObject::appendGeometry(std::vector<sf::Vertex>& triangles,
+                                     std::vector<sf::Vertex>& /*lines*/) const {
+    appendOutlinedRect(triangles, position_, size_, color_, sf::Color::Black, 2.0f);
 }
 
 TextObject::TextObject(const std::string& id)
@@ -54,36 +278,69 @@ TextObject::TextObject(const std::string& id)
     color_ = sf::Color::Transparent;
 }
 
-void TextObject::draw(sf::RenderWindow& window) const {
-    if (!text_.empty()) {
-        sf::Text text(font_, text_, 20);
-        text.setPosition(position_);
-        text.setFillColor(sf::Color::Black);
-        window.draw(text);
-    }
+void TextObject::drawOverlay(sf::RenderTarget& target) const {
+    syncLabel();
+    label_.draw(target);
 }
 
-void TextObject::update(const VariableDatabase& db) {
-    VisualObject::update(db);
+bool TextObject::hasOverlay() const {
+    return !text_.empty();
+}
+
+sf::FloatRect TextObject::getDrawBounds() const {
+    // Text is not clipped to the object, long values run past its right edge
+    syncLabel();
+    return drawBoundsWith(label_);
+}
+
+void TextObject::syncLabel() const {
+    label_.set(*font_, text_, 20, position_, sf::Color::Black);
 }
 
 LineObject::LineObject(const std::string& id)
     : VisualObject(ObjectType::Line, id),
       startPoint_(0, 0), endPoint_(100, 100) {
+    size_ = endPoint_ - startPoint_;
     color_ = sf::Color::Black;
 }
 
-void LineObject::draw(sf::RenderWindow& window) const {
-    sf::Vertex line[] = {
-        sf::Vertex{startPoint_, color_},
-        sf::Vertex{endPoint_, color_}
-    };
-    window.draw(line, 2, sf::PrimitiveType::Lines);
+void LineObject::appendGeometry(std::vector<sf::Vertex>& /*triangles*/,
+                                std::vector<sf::Vertex>& lines) const {
+    lines.push_back(sf::Vertex{startPoint_, color_});
+    lines.push_back(sf::Vertex{endPoint_, color_});
 }
 
 void LineObject::setPoints(const sf::Vector2f& start, const sf::Vector2f& end) {
     startPoint_ = start;
     endPoint_ = end;
+    
+    // Bounds follow the segment so hit-testing matches what is drawn
+    startRight_ = start.x > end.x;
+    startBelow_ = start.y > end.y;
+    position_ = sf::Vector2f(std::min(start.x, end.x), std::min(start.y, end.y));
+    size_ = sf::Vector2f(std::abs(end.x - start.x), std::abs(end.y - start.y));
+    invalidateBounds();
+    // Exactly as given, without the rounding of position + size
+    startPoint_ = start;
+    endPoint_ = end;
+}
+
+bool LineObject::contains(const sf::Vector2f& point) const {
+    return nearSegment(point, startPoint_, endPoint_, HitDistance);
+}
+
+sf::FloatRect LineObject::getBounds() const {
+    const sf::Vector2f margin(HitDistance, HitDistance);
+    return sf::FloatRect(position_ - margin, size_ + margin + margin);
+}
+
+void LineObject::onBoundsChanged() {
+    // setPosition() and setSize() move the box; the points keep their corners
+    const sf::Vector2f farCorner = position_ + size_;
+    startPoint_ = sf::Vector2f(startRight_ ? farCorner.x : position_.x,
+                               startBelow_ ? farCorner.y : position_.y);
+    endPoint_ = sf::Vector2f(startRight_ ? position_.x : farCorner.x,
+                             startBelow_ ? position_.y : farCorner.y);
 }
 
 PolylineObject::PolylineObject(const std::string& id)
@@ -91,23 +348,66 @@ PolylineObject::PolylineObject(const std::string& id)
     color_ = sf::Color::Blue;
 }
 
-void PolylineObject::draw(sf::RenderWindow& window) const {
+void PolylineObject::appendGeometry(std::vector<sf::Vertex>& /*triangles*/,
+                                    std::vector<sf::Vertex>& lines) const {
     if (points_.size() < 2) return;
     
-    std::vector<sf::Vertex> vertices;
     for (size_t i = 0; i < points_.size() - 1; ++i) {
-        vertices.emplace_back(sf::Vertex{position_ + points_[i], color_});
-        vertices.emplace_back(sf::Vertex{position_ + points_[i + 1], color_});
+        lines.push_back(sf::Vertex{position_ + points_[i], color_});
+        lines.push_back(sf::Vertex{position_ + points_[i + 1], color_});
     }
-    window.draw(vertices.data(), vertices.size(), sf::PrimitiveType::Lines);
 }
 
 void PolylineObject::addPoint(const sf::Vector2f& point, bool absolute) {
-    if (absolute) {
-        points_.push_back(point - position_);
-    } else {
-        points_.push_back(point);
+    points_.push_back(absolute ? point - position_ : point);
+    
+    // Bounds follow the points, as for LineObject: the position moves to the
+    // top-left corner of their box and the points stay relative to it
+    sf::Vector2f low = points_.front();
+    sf::Vector2f high = points_.front();
+    for (const sf::Vector2f& p : points_) {
+        low = sf::Vector2f(std::min(low.x, p.x), std::min(low.y, p.y));
+        high = sf::Vector2f(std::max(high.x, p.x), std::max(high.y, p.y));
+    }
+    for (sf::Vector2f& p : points_) {
+        p -= low;
+    }
+    position_ += low;
+    size_ = high - low;
+    laidOutSize_ = size_;
+    invalidateBounds();
+}
+
+bool PolylineObject::contains(const sf::Vector2f& point) const {
+    if (points_.size() == 1) {
+        return nearSegment(point, position_ + points_[0], position_ + points_[0], LineObject::HitDistance);
+    }
+    for (std::size_t i = 1; i < points_.size(); ++i) {
+        if (nearSegment(point, position_ + points_[i - 1], position_ + points_[i], LineObject::HitDistance)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+sf::FloatRect PolylineObject::getBounds() const {
+    const sf::Vector2f margin(LineObject::HitDistance, LineObject::HitDistance);
+    return sf::FloatRect(position_ - margin, size_ + margin + margin);
+}
+
+void PolylineObject::onBoundsChanged() {
+    // setSize() stretches the points to the new box; an axis they do not
+    // span has no extent to stretch
+    if (points_.empty() || size_ == laidOutSize_) return;
+    
+    const sf::Vector2f scale(laidOutSize_.x > 0.0f ? size_.x / laidOutSize_.x : 0.0f,
+                             laidOutSize_.y > 0.0f ? size_.y / laidOutSize_.y : 0.0f);
+    for (sf::Vector2f& p : points_) {
+        p = p.componentWiseMul(scale);
     }
+    size_ = size_.componentWiseMul(sf::Vector2f(laidOutSize_.x > 0.0f ? 1.0f : 0.0f,
+                                                laidOutSize_.y > 0.0f ? 1.0f : 0.0f));
+    laidOutSize_ = size_;
 }
 
 ButtonObject::ButtonObject(const std::string& id)
@@ -115,21 +415,29 @@ ButtonObject::ButtonObject(const std::string& id)
     color_ = sf::Color(100, 150, 200);
 }
 
-void ButtonObject::draw(sf::RenderWindow& window) const {
-    sf::RectangleShape shape;
-    shape.setPosition(position_);
-    shape.setSize(size_);
-    shape.setFillColor(isPressed_ ? sf::Color(80, 130, 180) : color_);
-    shape.setOutlineColor(sf::Color::Black);
-    shape.setOutlineThickness(2.0f);
-    window.draw(shape);
-    
-    if (!text_.empty()) {
-        sf::Text btnText(font_, text_, 16);
-        btnText.setPosition(position_ + sf::Vector2f(10, 10));
-        btnText.setFillColor(sf::Color::White);
-        window.draw(btnText);
-    }
+void ButtonObject::appendGeometry(std::vector<sf::Vertex>& triangles,
+                                  std::vector<sf::Vertex>& /*lines*/) const {
+    appendOutlinedRect(triangles, position_, size_,
+                       isPressed_ ? sf::Color(80, 130, 180) : color_,
+                       sf::Color::Black, 2.0f);
+}
+
+void ButtonObject::drawOverlay(sf::RenderTarget& target) const {
+    syncLabel();
+    label_.draw(target);
+}
+
+bool ButtonObject::hasOverlay() const {
+    return !text_.empty();
+}
+
+sf::FloatRect ButtonObject::getDrawBounds() const {
+    syncLabel();
+    return drawBoundsWith(label_);
+}
+
+void ButtonObject::syncLabel() const {
+    label_.set(*font_, text_, 16, position_ + sf::Vector2f(10, 10), sf::Color::White);
 }
 
 bool ButtonObject::contains(const sf::Vector2f& point) const {
@@ -142,6 +450,7 @@ void ButtonObject::setCallback(Callback callback) {
 
 void ButtonObject::onClick() {
     isPressed_ = !isPressed_;
+    invalidateGeometry();
     if (callback_) {
         callback_();
     }
@@ -152,20 +461,29 @@ InputFieldObject::InputFieldObject(const std::string& id)
     color_ = sf::Color::White;
 }
 
-void InputFieldObject::draw(sf::RenderWindow& window) const {
-    sf::RectangleShape shape;
-    shape.setPosition(position_);
-    shape.setSize(size_);
-    shape.setFillColor(isActive_ ? sf::Color(240, 240, 255) : color_);
-    shape.setOutlineColor(sf::Color::Black);
-    shape.setOutlineThickness(2.0f);
-    window.draw(shape);
-    
-    std::string displayText = inputText_ + (isActive_ ? "|" : "");
-    sf::Text fieldText(font_, displayText, 16);
-    fieldText.setPosition(position_ + sf::Vector2f(5, 5));
-    fieldText.setFillColor(sf::Color::Black);
-    window.draw(fieldText);
+void InputFieldObject::appendGeometry(std::vector<sf::Vertex>& triangles,
+                                      std::vector<sf::Vertex>& /*lines*/) const {
+    appendOutlinedRect(triangles, position_, size_,
+                       isActive_ ? sf::Color(240, 240, 255) : color_,
+                       sf::Color::Black, 2.0f);
+}
+
+void InputFieldObject::drawOverlay(sf::RenderTarget& target) const {
+    syncLabel();
+    label_.draw(target);
+}
+
+bool InputFieldObject::hasOverlay() const {
+    return !displayText_.empty();
+}
+
+sf::FloatRect InputFieldObject::getDrawBounds() const {
+    syncLabel();
+    return drawBoundsWith(label_);
+}
+
+void InputFieldObject::syncLabel() const {
+    label_.set(*font_, displayText_, 16, position_ + sf::Vector2f(5, 5), sf::Color::Black);
 }
 
 void InputFieldObject::handleTextEntered(uint32_t unicode) {
@@ -176,49 +494,74 @@ void InputFieldObject::handleTextEntered(uint32_t unicode) {
     } else if (unicode >= 32 && unicode < 127) {
         inputText_ += static_cast<char>(unicode);
     }
+    updateDisplayText();
 }
 
 void InputFieldObject::setActive(bool active) {
-    isActive_ = active;
+    if (isActive_ != active) {
+        isActive_ = active;
+        updateDisplayText();
+    }
+}
+
+void InputFieldObject::updateDisplayText() {
+    displayText_ = inputText_;
+    if (isActive_) {
+        displayText_ += '|';
+    }
+    invalidateGeometry();
 }
 
 HistoryGraphObject::HistoryGraphObject(const std::string& id)
     : VisualObject(ObjectType::HistoryGraph, id) {
     color_ = sf::Color(150, 200, 150);
+    updateBucketSize();
     for (int i = 0; i < 10; ++i) {
-        values_.push_back(30 + rand() % 50);
+        addValue(30 + rand() % 50);
     }
 }
 
-void HistoryGraphObject::draw(sf::RenderWindow& window) const {
-    sf::RectangleShape background;
-    background.setPosition(position_);
-    background.setSize(size_);
-    background.setFillColor(sf::Color(240, 240, 240));
-    background.setOutlineColor(sf::Color(180, 180, 180));
-    background.setOutlineThickness(2.0f);
-    window.draw(background);
+void HistoryGraphObject::appendGeometry(std::vector<sf::Vertex>& triangles,
+                                        std::vector<sf::Vertex>& /*lines*/) const {
+    appendOutlinedRect(triangles, position_, size_, sf::Color(240, 240, 240),
+                       sf::Color(180, 180, 180), 2.0f);
     
-    if (values_.empty()) return;
+    const auto& buckets = history_.buckets();
+    if (buckets.empty()) return;
     
-    float barWidth = size_.x / values_.size();
-    for (size_t i = 0; i < values_.size(); ++i) {
-        float barHeight = (values_[i] / maxValue_) * size_.y;
-        
-        sf::RectangleShape bar;
-        bar.setPosition(sf::Vector2f(position_.x + i * barWidth, 
-                                     position_.y + size_.y - barHeight));
-        bar.setSize(sf::Vector2f(barWidth - 2, barHeight));
-        bar.setFillColor(color_);
-        window.draw(bar);
+    // Autoscale from the incrementally maintained extremes. Bars start at
+    // zero, so the range always includes it; the headroom is a share of the
+    // range, which stays above the maximum for negative values too.
+    float low = std::min(0.0f, history_.minValue());
+    float high = std::max(0.0f, history_.maxValue());
+    high += 0.1f * (high - low);
+    if (high <= low) high = low + 1.0f;
+    float scale = size_.y / (high - low);
+    
+    std::size_t bucketSize = history_.bucketSize();
+    std::size_t columns = (history_.capacity() + bucketSize - 1) / bucketSize;
+    columns = std::max(columns, buckets.size());
+    float columnWidth = size_.x / columns;
+    float gap = bucketSize == 1 ? 2.0f : 0.0f;
+    float bottom = position_.y + size_.y;
+    
+    std::uint64_t firstSequence = buckets.front().firstSequence;
+    for (const auto& bucket : buckets) {
+        float column = static_cast<float>((bucket.firstSequence - firstSequence) / bucketSize);
+        // One sample per column is drawn as a bar, decimated columns as a min/max span
+        float top = bottom - (bucket.max - low) * scale;
+        float base = bucketSize == 1 ? bottom - (0.0f - low) * scale
+                                     : bottom - (bucket.min - low) * scale;
+        float height = std::max(base - top, 1.0f);
+        appendQuad(triangles, sf::Vector2f(position_.x + column * columnWidth, top),
+                   sf::Vector2f(std::max(columnWidth - gap, 1.0f), height), color_);
     }
 }
 
 void HistoryGraphObject::update(const VariableDatabase& db) {
-    VisualObject::update(db);
-    if (!boundVariable_.empty()) {
-        if (auto value = db.getVariableAs<float>(boundVariable_)) {
-            addValue(*value);
+    if (auto value = evaluateBinding(db)) {
+        if (auto number = toNumber(*value)) {
+            addValue(static_cast<float>(*number));
         }
     }
 }
@@ -228,12 +571,46 @@ bool HistoryGraphObject::contains(const sf::Vector2f& point) const {
 }
 
 void HistoryGraphObject::addValue(float value) {
-    values_.push_back(value);
-    if (values_.size() > 20) {
-        values_.erase(values_.begin());
+    addValue(value, now());
+}
+
+void HistoryGraphObject::addValue(float value, double timestamp) {
+    history_.push(timestamp, value);
+    invalidateGeometry();
+}
+
+std::size_t HistoryGraphObject::backfill(const Historian& historian, double from, double to) {
+    std::vector<Historian::Sample> samples;
+    historian.query(boundVariable_, from, to, samples);
+    
+    history_.clear();
+    for (const auto& sample : samples) {
+        history_.push(sample.time, static_cast<float>(sample.value));
     }
-    if (value > maxValue_) {
-        maxValue_ = value * 1.1f;
+    invalidateGeometry();
+    return samples.size();
+}
+
+void HistoryGraphObject::setHistoryDepth(std::size_t depth) {
+    history_.setCapacity(depth);
+    updateBucketSize();
+    invalidateGeometry();
+}
+
+double HistoryGraphObject::now() {
+    return Historian::now();
+}
+
+void HistoryGraphObject::onBoundsChanged() {
+    updateBucketSize();
+}
+
+void HistoryGraphObject::updateBucketSize() {
+    // At most one bucket per pixel column
+    std::size_t columns = static_cast<std::size_t>(std::max(size_.x, 1.0f));
+    std::size_t bucketSize = (history_.capacity() + columns - 1) / columns;
+    if (bucketSize != history_.bucketSize()) {
+        history_.setBucketSize(bucketSize);
     }
 }
 
@@ -242,39 +619,80 @@ ImageObject::ImageObject(const std::string& id)
     color_ = sf::Color(200, 200, 200);
 }
 
-void ImageObject::draw(sf::RenderWindow& window) const {
-    if (textureLoaded_) {
-        sf::Sprite sprite(texture_);
-        sprite.setPosition(position_);
-        sprite.setScale(sf::Vector2f(size_.x / texture_.getSize().x, 
-                                      size_.y / texture_.getSize().y));
-        window.draw(sprite);
-    } else {
-        sf::RectangleShape placeholder;
-        placeholder.setPosition(position_);
-        placeholder.setSize(size_);
-        placeholder.setFillColor(color_);
-        placeholder.setOutlineColor(sf::Color::Black);
-        placeholder.setOutlineThickness(2.0f);
-        window.draw(placeholder);
-        
-        sf::Text text(font_, "Image", 20);
-        text.setPosition(position_ + sf::Vector2f(10, 10));
-        text.setFillColor(sf::Color::Black);
-        window.draw(text);
+void ImageObject::appendGeometry(std::vector<sf::Vertex>& triangles,
+                                 std::vector<sf::Vertex>& /*lines*/) const {
+    if (!imageReady_) {
+        appendOutlinedRect(triangles, position_, size_, color_, sf::Color::Black, 2.0f);
     }
 }
 
+const sf::Texture* ImageObject::appendTexturedGeometry(std::vector<sf::Vertex>& triangles) const {
+    if (!imageReady_) return nullptr;
+    
+    const sf::IntRect& rect = image_->rect;
+    sf::Vector2f texTopLeft(rect.position);
+    sf::Vector2f texBottomRight(rect.position + rect.size);
+    sf::Vector2f bottomRight = position_ + size_;
+    
+    sf::Vertex topLeftVertex{position_, sf::Color::White, texTopLeft};
+    sf::Vertex topRightVertex{sf::Vector2f(bottomRight.x, position_.y), sf::Color::White,
+                              sf::Vector2f(texBottomRight.x, texTopLeft.y)};
+    sf::Vertex bottomRightVertex{bottomRight, sf::Color::White, texBottomRight};
+    sf::Vertex bottomLeftVertex{sf::Vector2f(position_.x, bottomRight.y), sf::Color::White,
+                                sf::Vector2f(texTopLeft.x, texBottomRight.y)};
+    
+    triangles.push_back(topLeftVertex);
+    triangles.push_back(topRightVertex);
+    triangles.push_back(bottomRightVertex);
+    triangles.push_back(topLeftVertex);
+    triangles.push_back(bottomRightVertex);
+    triangles.push_back(bottomLeftVertex);
+    return image_->texture;
+}
+
+void ImageObject::drawOverlay(sf::RenderTarget& target) const {
+    if (!imageReady_) {
+        syncPlaceholder();
+        placeholderLabel_.draw(target);
+    }
+}
+
+bool ImageObject::hasOverlay() const {
+    return !imageReady_;
+}
+
+sf::FloatRect ImageObject::getDrawBounds() const {
+    if (imageReady_) return VisualObject::getDrawBounds();
+    syncPlaceholder();
+    return drawBoundsWith(placeholderLabel_);
+}
+
+void ImageObject::syncPlaceholder() const {
+    static const std::string placeholder = "Image";
+    placeholderLabel_.set(*font_, placeholder, 20, position_ + sf::Vector2f(10, 10),
+                          sf::Color::Black);
+}
+
 bool ImageObject::contains(const sf::Vector2f& point) const {
     return getBounds().contains(point);
 }
 
 bool ImageObject::loadFromFile(const std::string& filename) {
-    if (texture_.loadFromFile(filename)) {
-        textureLoaded_ = true;
-        return true;
-    }
-    return false;
+    imagePath_ = filename;
+    image_ = ResourceCache::instance().getImage(filename);
+    imageReady_ = false;
+    refreshImage();
+    invalidateGeometry();
+    return image_->state != AtlasImage::State::Failed;
+}
+
+bool ImageObject::refreshImage() {
+    bool ready = image_ && image_->state == AtlasImage::State::Ready;
+    if (ready == imageReady_) return false;
+    
+    imageReady_ = ready;
+    invalidateGeometry();
+    return true;
 }
 
-} // namespace xsmall_hmi
\ No newline at end of file
+} // namespace xsmall_hmi
@@ -5,10 +5,19 @@
 #include <vector>
 #include <functional>
 #include <cstdint>
+#include <optional>
+#include "VariableDatabase.hpp"
+#include "Expression.hpp"
+#include "ValueFormat.hpp"
+#include "HistoryBuffer.hpp"
 
 namespace xsmall_hmi {
 
-class VariableDatabase;
+class SpatialIndex;
+class SceneStore;
+class BindingTracker;
+class Historian;
+struct AtlasImage;
 
 enum class ObjectType {
     Rectangle,
@@ -21,12 +30,40 @@ enum class ObjectType {
     Image
 };
 
+// sf::Text kept between frames. Glyph layout only reruns when the string,
+// character size or position passed to set() actually changes.
+class CachedText {
+public:
+    void set(const sf::Font& font, const std::string& string, unsigned int characterSize,
+             const sf::Vector2f& position, const sf::Color& color);
+    void draw(sf::RenderTarget& target) const;
+    // Area the last set() string covers; empty before the first
+    sf::FloatRect bounds() const;
+    
+private:
+    std::optional<sf::Text> text_;
+    std::string string_;
+};
+
 class VisualObject {
 public:
     VisualObject(ObjectType type, const std::string& id);
-    virtual ~VisualObject() = default;
+    virtual ~VisualObject();
     
-    virtual void draw(sf::RenderWindow& window) const = 0;
+    // Immediate-mode draw: the object's geometry followed by its overlay
+    virtual void draw(sf::RenderTarget& target) const;
+    // Untextured geometry that SceneRenderer batches across all objects
+    virtual void appendGeometry(std::vector<sf::Vertex>& /*triangles*/,
+                                std::vector<sf::Vertex>& /*lines*/) const {}
+    // Textured quads sampling one texture, batched with neighbours on the
+    // same texture; returns the texture, or null when nothing was appended
+    virtual const sf::Texture* appendTexturedGeometry(std::vector<sf::Vertex>& /*triangles*/) const {
+        return nullptr;
+    }
+    // Parts that cannot be batched (text), drawn after the object's geometry
+    virtual void drawOverlay(sf::RenderTarget& /*target*/) const {}
+    // Whether drawOverlay() draws anything; a change bumps the geometry version
+    virtual bool hasOverlay() const { return false; }
     virtual void update(const VariableDatabase& db);
     virtual bool contains(const sf::Vector2f& point) const;
     
@@ -34,11 +71,32 @@ public:
     void setSize(const sf::Vector2f& size);
     void setColor(const sf::Color& color);
     void setText(const std::string& text);
-    void setVariableBinding(const std::string& varName);
+    // How update() writes bound values into the text, from the next value on
+    void setFormat(const FormatSpec& format);
+    // A variable name, or an Expression after '=' such as "=temp_c * 1.8 + 32"
+    void setVariableBinding(const std::string& binding);
+    void setVariableBinding(VariableDatabase& db, const std::string& binding);
+    
+    // Compiles the binding, interning the variables it reads; returns them
+    const std::vector<VariableId>& resolveBinding(VariableDatabase& db);
     
     const std::string& getId() const { return id_; }
     ObjectType getType() const { return type_; }
-    sf::FloatRect getBounds() const;
+    const sf::Vector2f& getPosition() const { return position_; }
+    const sf::Vector2f& getSize() const { return size_; }
+    const sf::Color& getColor() const { return color_; }
+    const std::string& getText() const { return text_; }
+    const FormatSpec& getFormat() const { return format_; }
+    const std::string& getVariableBinding() const { return boundVariable_; }
+    const Expression& getBinding() const { return binding_; }
+    // The bound variable of a plain single-variable binding, otherwise invalid
+    VariableId getBoundId() const { return binding_.variable(); }
+    // Area that hit-testing and the spatial index go by
+    virtual sf::FloatRect getBounds() const;
+    // Everything draw() paints, outlines and overhanging labels included
+    virtual sf::FloatRect getDrawBounds() const;
+    // Bumped whenever appendGeometry() or drawOverlay() would draw differently
+    std::uint32_t getGeometryVersion() const { return geometryVersion_; }
     
 protected:
     ObjectType type_;
@@ -47,95 +105,228 @@ protected:
     sf::Vector2f size_;
     sf::Color color_;
     std::string text_;
+    FormatSpec format_;
     std::string boundVariable_;
-    sf::Font font_;
+    Expression binding_;
+    std::shared_ptr<const sf::Font> font_;
+    
+    // Current value of the binding; nothing while unbound or unresolved
+    std::optional<VariableDatabase::ValueType> evaluateBinding(const VariableDatabase& db);
+    void invalidateGeometry();
+    // Geometry change that also moves the bounds
+    void invalidateBounds();
+    virtual void onBoundsChanged() {}
+    sf::FloatRect drawBoundsWith(const CachedText& label) const;
+    
+private:
+    void reportBindingError() const;
+    
+    friend class SpatialIndex;
+    SpatialIndex* spatialIndex_ = nullptr;
+    std::uint32_t geometryVersion_ = 0;
+    friend class BindingTracker;
+    void setUpdatePending(bool pending);
+    BindingTracker* tracker_ = nullptr;
+    bool updatePending_ = false;
+    friend class SceneStore;
+    SceneStore* store_ = nullptr;
+    std::uint32_t storeSlot_ = 0;
 };
 
 class RectangleObject : public VisualObject {
 public:
+    static constexpr ObjectType StaticType = ObjectType::Rectangle;
+    
     RectangleObject(const std::string& id);
-    void draw(sf::RenderWindow& window) const override;
+    void appendGeometry(std::vector<sf::Vertex>& triangles,
+                        std::vector<sf::Vertex>& lines) const override;
 };
 
 class TextObject : public VisualObject {
 public:
+    static constexpr ObjectType StaticType = ObjectType::Text;
+    
     TextObject(const std::string& id);
-    void draw(sf::RenderWindow& window) const override;
-    void update(const VariableDatabase& db) override;
+    void drawOverlay(sf::RenderTarget& target) const override;
+    bool hasOverlay() const override;
+    sf::FloatRect getDrawBounds() const override;
+    
+private:
+    void syncLabel() const;
+    
+    mutable CachedText label_;
 };
 
 class LineObject : public VisualObject {
 public:
+    static constexpr ObjectType StaticType = ObjectType::Line;
+    
+    // Points this close to the segment hit it, so even a horizontal or
+    // vertical line has an area to pick
+    static constexpr float HitDistance = 3.0f;
+    
     LineObject(const std::string& id);
-    void draw(sf::RenderWindow& window) const override;
+    void appendGeometry(std::vector<sf::Vertex>& triangles,
+                        std::vector<sf::Vertex>& lines) const override;
+    bool contains(const sf::Vector2f& point) const override;
+    sf::FloatRect getBounds() const override;
+    // Moves the position and size to the segment's bounding box
     void setPoints(const sf::Vector2f& start, const sf::Vector2f& end);
+    const sf::Vector2f& getStartPoint() const { return startPoint_; }
+    const sf::Vector2f& getEndPoint() const { return endPoint_; }
+    
+protected:
+    void onBoundsChanged() override;
     
 private:
     sf::Vector2f startPoint_;
     sf::Vector2f endPoint_;
+    // Corners of the bounding box the start point sits on
+    bool startRight_ = false;
+    bool startBelow_ = false;
 };
 
 class PolylineObject : public VisualObject {
 public:
+    static constexpr ObjectType StaticType = ObjectType::Polyline;
+    
     PolylineObject(const std::string& id);
-    void draw(sf::RenderWindow& window) const override;
+    void appendGeometry(std::vector<sf::Vertex>& triangles,
+                        std::vector<sf::Vertex>& lines) const override;
+    bool contains(const sf::Vector2f& point) const override;
+    sf::FloatRect getBounds() const override;
+    // Grows the position and size to the points' bounding box
     void addPoint(const sf::Vector2f& point, bool absolute = false);
+    // Relative to the object's position, which is their top-left corner
+    const std::vector<sf::Vector2f>& getPoints() const { return points_; }
+    
+protected:
+    void onBoundsChanged() override;
     
 private:
     std::vector<sf::Vector2f> points_;
+    // Size the points were laid out for; setSize() scales from it
+    sf::Vector2f laidOutSize_;
 };
 
 class ButtonObject : public VisualObject {
 public:
+    static constexpr ObjectType StaticType = ObjectType::Button;
+    
     using Callback = std::function<void()>;
     
     ButtonObject(const std::string& id);
-    void draw(sf::RenderWindow& window) const override;
+    void appendGeometry(std::vector<sf::Vertex>& triangles,
+                        std::vector<sf::Vertex>& lines) const override;
+    void drawOverlay(sf::RenderTarget& target) const override;
+    bool hasOverlay() const override;
+    sf::FloatRect getDrawBounds() const override;
     bool contains(const sf::Vector2f& point) const override;
     void setCallback(Callback callback);
     void onClick();
     
 private:
+    void syncLabel() const;
+    
     Callback callback_;
     bool isPressed_ = false;
+    mutable CachedText label_;
 };
 
 class InputFieldObject : public VisualObject {
 public:
+    static constexpr ObjectType StaticType = ObjectType::InputField;
+    
     InputFieldObject(const std::string& id);
-    void draw(sf::RenderWindow& window) const override;
+    void appendGeometry(std::vector<sf::Vertex>& triangles,
+                        std::vector<sf::Vertex>& lines) const override;
+    void drawOverlay(sf::RenderTarget& target) const override;
+    bool hasOverlay() const override;
+    sf::FloatRect getDrawBounds() const override;
     void handleTextEntered(uint32_t unicode);
     void setActive(bool active);
     bool isActive() const { return isActive_; }
     
 private:
+    void updateDisplayText();
+    void syncLabel() const;
+    
     bool isActive_ = false;
     std::string inputText_;
+    std::string displayText_;
+    mutable CachedText label_;
 };
 
 class HistoryGraphObject : public VisualObject {
 public:
+    static constexpr ObjectType StaticType = ObjectType::HistoryGraph;
+    
     HistoryGraphObject(const std::string& id);
-    void draw(sf::RenderWindow& window) const override;
+    void appendGeometry(std::vector<sf::Vertex>& triangles,
+                        std::vector<sf::Vertex>& lines) const override;
     void update(const VariableDatabase& db) override;
     bool contains(const sf::Vector2f& point) const override;
     void addValue(float value);
+    void addValue(float value, double timestamp);
+    
+    // Number of samples kept; drawing cost does not depend on it
+    void setHistoryDepth(std::size_t depth);
+    const HistoryBuffer& getHistory() const { return history_; }
+    // Replaces the history with the bound variable's recorded [from, to] target
+    std::size_t backfill(const Historian& historian, double from, double to);
+    
+    // Wall-clock seconds, the time base of history timestamps
+    static double now();
+    
+protected:
+    void onBoundsChanged() override;
     
 private:
-    std::vector<float> values_;
-    float maxValue_ = 100.0f;
+    void updateBucketSize();
+    
+    HistoryBuffer history_{20};
 };
 
 class ImageObject : public VisualObject {
 public:
+    static constexpr ObjectType StaticType = ObjectType::Image;
+    
     ImageObject(const std::string& id);
-    void draw(sf::RenderWindow& window) const override;
+    void appendGeometry(std::vector<sf::Vertex>& triangles,
+                        std::vector<sf::Vertex>& lines) const override;
+    const sf::Texture* appendTexturedGeometry(std::vector<sf::Vertex>& triangles) const override;
+    void drawOverlay(sf::RenderTarget& target) const override;
+    bool hasOverlay() const override;
+    sf::FloatRect getDrawBounds() const override;
     bool contains(const sf::Vector2f& point) const override;
+    // Starts decoding in the background; false only if the file is known
+    // to be unreadable. The placeholder is drawn until the image is ready.
     bool loadFromFile(const std::string& filename);
+    const std::string& getImagePath() const { return imagePath_; }
+    
+    // Picks up a decode that finished since the last call; true if the
+    // object now draws differently
+    bool refreshImage();
+    bool isImageReady() const { return imageReady_; }
     
 private:
-    sf::Texture texture_;
-    bool textureLoaded_ = false;
+    void syncPlaceholder() const;
+    
+    std::string imagePath_;
+    std::shared_ptr<const AtlasImage> image_;
+    bool imageReady_ = false;
+    mutable CachedText placeholderLabel_;
 };
 
-} // namespace xsmall_hmi
\ No newline at end of file
+// Checked downcast through the stored ObjectType instead of RTTI
+template<typename T>
+T* objectCast(VisualObject* object) {
+    return object && object->getType() == T::StaticType ? static_cast<T*>(object) : nullptr;
+}
+
+template<typename T>
+const T* objectCast(const VisualObject* object) {
+    return object && object->getType() == T::StaticType ? static_cast<const T*>(object) : nullptr;
+}
+
+} // namespace xsmall_hmi
@@ -0,0 +1,416 @@
+#include <benchmark/benchmark.h>
+#include "VariableDatabase.hpp"
+#include "BindingTracker.hpp"
+#include "Expression.hpp"
+#include "SpatialIndex.hpp"
+#include "VisualObject.hpp"
+#include "SceneFile.hpp"
+#include "SceneStore.hpp"
+#include "ThreadPool.hpp"
+#include "Ingestion.hpp"
+#include "ValueFormat.hpp"
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <thread>
+#include <string>
+#include <vector>
+
+namespace {
+
+using xsmall_hmi::VariableDatabase;
+
+// setVariable with 0, 1 and N subscribers on the written variable
+void BM_SetVariable(benchmark::State& state) {
+    VariableDatabase db;
+    auto id = db.resolveId("tag");
+    int fired = 0;
+    std::vector<xsmall_hmi::Subscription> subscriptions;
+    for (int64_t i = 0; i < state.range(0); ++i) {
+        subscriptions.push_back(
+            db.subscribe(id, [&fired](const std::string&, const VariableDatabase::ValueType&) { ++fired; }));
+    }
+    
+    float value = 0.0f;
+    for (auto _ : state) {
+        db.setVariable(id, value);
+        value += 1.0f;
+    }
+    benchmark::DoNotOptimize(fired);
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SetVariable)->Arg(0)->Arg(1)->Arg(16);
+
+// Noisy analog tag (+-0.2 around 50) with 16 subscribers, unfiltered (0)
+// against a 0.5 absolute deadband (1); the counter shows callbacks per write
+void BM_SetVariableNoisy(benchmark::State& state) {
+    VariableDatabase db;
+    auto id = db.resolveId("tag");
+    xsmall_hmi::SubscribeOptions options;
+    if (state.range(0)) {
+        options.deadband = xsmall_hmi::SubscribeOptions::Deadband::Absolute;
+        options.deadbandValue = 0.5;
+    }
+    int64_t fired = 0;
+    std::vector<xsmall_hmi::Subscription> subscriptions;
+    for (int i = 0; i < 16; ++i) {
+        subscriptions.push_back(db.subscribe(
+            id, [&fired](const std::string&, const VariableDatabase::ValueType&) { ++fired; }, options));
+    }
+    
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> noise(-0.2f, 0.2f);
+    for (auto _ : state) {
+        db.setVariable(id, 50.0f + noise(rng));
+    }
+    state.counters["callbacks/write"] = static_cast<double>(fired) / static_cast<double>(state.iterations());
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SetVariableNoisy)->Arg(0)->Arg(1);
+
+void BM_SetVariableByName(benchmark::State& state) {
+    VariableDatabase db;
+    const std::string name = "plant.area1.pump_station.discharge_pressure";
+    db.setVariable(name, 0.0f);
+    
+    float value = 0.0f;
+    for (auto _ : state) {
+        db.setVariable(name, value);
+        value += 1.0f;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SetVariableByName);
+
+// Derived value computed at update time instead of written from outside:
+// a plain binding (0) against a compiled expression over three inputs (1)
+void BM_EvaluateBinding(benchmark::State& state) {
+    VariableDatabase db;
+    db.setVariable("temp_c", 21.5f);
+    db.setVariable("pumpA", true);
+    db.setVariable("fault", false);
+    
+    xsmall_hmi::Expression expression;
+    expression.compile(state.range(0) ? "=pumpA && !fault ? temp_c * 1.8 + 32 : 0" : "temp_c", db);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(expression.evaluate(db));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_EvaluateBinding)->Arg(0)->Arg(1);
+
+// Numeric readout written into a text: the same value again (0), which
+// leaves the text alone, against a new value every time (1)
+void BM_FormatReadout(benchmark::State& state) {
+    xsmall_hmi::FormatSpec spec;
+    spec.precision = 1;
+    spec.prefix = "Flow: ";
+    spec.suffix = " m3/h";
+    std::string text;
+    float value = 42.5f;
+    
+    for (auto _ : state) {
+        if (state.range(0)) value += 0.1f;
+        benchmark::DoNotOptimize(xsmall_hmi::formatValue(value, spec, text));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_FormatReadout)->Arg(0)->Arg(1);
+
+void BM_GetVariableAsHit(benchmark::State& state) {
+    VariableDatabase db;
+    const std::string name = "plant.area1.pump_station.discharge_pressure";
+    db.setVariable(name, 1.5f);
+    
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(db.getVariableAs<float>(name));
+    }
+}
+BENCHMARK(BM_GetVariableAsHit);
+
+void BM_GetVariableAsHitById(benchmark::State& state) {
+    VariableDatabase db;
+    auto id = db.resolveId("plant.area1.pump_station.discharge_pressure");
+    db.setVariable(id, 1.5f);
+    
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(db.getVariableAs<float>(id));
+    }
+}
+BENCHMARK(BM_GetVariableAsHitById);
+
+void BM_GetVariableAsMiss(benchmark::State& state) {
+    VariableDatabase db;
+    db.setVariable("present", 1.5f);
+    const std::string missing = "plant.area1.pump_station.missing_tag";
+    
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(db.getVariableAs<float>(missing));
+    }
+}
+BENCHMARK(BM_GetVariableAsMiss);
+
+struct BoundScene {
+    VariableDatabase db;
+    std::vector<std::unique_ptr<xsmall_hmi::VisualObject>> objects;
+    std::vector<xsmall_hmi::VariableId> tags;
+    
+    explicit BoundScene(std::size_t count) {
+        for (std::size_t i = 0; i < count; ++i) {
+            tags.push_back(db.resolveId("tag_" + std::to_string(i)));
+            db.setVariable(tags.back(), std::string("value"));
+            
+            auto text = std::make_unique<xsmall_hmi::TextObject>("text_" + std::to_string(i));
+            text->setVariableBinding(db, db.getName(tags.back()));
+            objects.push_back(std::move(text));
+        }
+    }
+};
+
+// Polling: every bound object re-reads its variable each frame
+void BM_UpdateSweepAll(benchmark::State& state) {
+    BoundScene scene(static_cast<std::size_t>(state.range(0)));
+    
+    for (auto _ : state) {
+        for (auto& obj : scene.objects) {
+            obj->update(scene.db);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_UpdateSweepAll)->Arg(1000)->Arg(10000)->Arg(100000);
+
+// Change-driven: 1% of the tags change per frame, only dependents update
+void BM_UpdateDirtyOnly(benchmark::State& state) {
+    BoundScene scene(static_cast<std::size_t>(state.range(0)));
+    xsmall_hmi::BindingTracker tracker(scene.db);
+    for (auto& obj : scene.objects) {
+        tracker.track(obj.get());
+    }
+    tracker.updateDirty();
+    
+    std::size_t changes = std::max<std::size_t>(1, scene.tags.size() / 100);
+    std::size_t cursor = 0;
+    for (auto _ : state) {
+        for (std::size_t i = 0; i < changes; ++i) {
+            scene.db.setVariable(scene.tags[cursor++ % scene.tags.size()], std::string("changed"));
+        }
+        tracker.updateDirty();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_UpdateDirtyOnly)->Arg(1000)->Arg(10000)->Arg(100000);
+
+// Burst: every tag changes in one frame, updated on the UI thread (0) or
+// split across a pool with one worker per remaining core (1)
+void BM_UpdateBurst(benchmark::State& state) {
+    BoundScene scene(50000);
+    xsmall_hmi::BindingTracker tracker(scene.db);
+    std::unique_ptr<xsmall_hmi::ThreadPool> pool;
+    if (state.range(0)) {
+        pool = std::make_unique<xsmall_hmi::ThreadPool>();
+        tracker.setThreadPool(pool.get());
+    }
+    for (auto& obj : scene.objects) {
+        tracker.track(obj.get());
+    }
+    tracker.updateDirty();
+    
+    int round = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        const std::string value = "burst " + std::to_string(round++);
+        for (auto tag : scene.tags) {
+            scene.db.setVariable(tag, value);
+        }
+        state.ResumeTiming();
+        tracker.updateDirty();
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(scene.objects.size()));
+}
+BENCHMARK(BM_UpdateBurst)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+
+struct ClickScene {
+    std::vector<std::unique_ptr<xsmall_hmi::VisualObject>> objects;
+    xsmall_hmi::SpatialIndex index;
+    std::vector<sf::Vector2f> clicks;
+    
+    explicit ClickScene(std::size_t count) {
+        std::mt19937 rng(42);
+        std::uniform_real_distribution<float> x(0.0f, 4000.0f);
+        std::uniform_real_distribution<float> y(0.0f, 3000.0f);
+        
+        for (std::size_t i = 0; i < count; ++i) {
+            auto rect = std::make_unique<xsmall_hmi::RectangleObject>("rect_" + std::to_string(i));
+            rect->setPosition(sf::Vector2f(x(rng), y(rng)));
+            rect->setSize(sf::Vector2f(40, 25));
+            index.insert(rect.get());
+            objects.push_back(std::move(rect));
+        }
+        for (int i = 0; i < 1024; ++i) {
+            clicks.emplace_back(x(rng), y(rng));
+        }
+    }
+};
+
+void BM_HitTestSpatialIndex(benchmark::State& state) {
+    ClickScene scene(static_cast<std::size_t>(state.range(0)));
+    std::vector<xsmall_hmi::VisualObject*> hits;
+    std::size_t click = 0;
+    
+    for (auto _ : state) {
+        hits.clear();
+        scene.index.queryPoint(scene.clicks[click++ % scene.clicks.size()], hits);
+        benchmark::DoNotOptimize(hits.data());
+    }
+}
+BENCHMARK(BM_HitTestSpatialIndex)->Arg(1000)->Arg(10000)->Arg(100000);
+
+// Baseline: the reverse linear scan the Editor used before the index
+void BM_HitTestLinearScan(benchmark::State& state) {
+    ClickScene scene(static_cast<std::size_t>(state.range(0)));
+    std::size_t click = 0;
+    
+    for (auto _ : state) {
+        const sf::Vector2f& point = scene.clicks[click++ % scene.clicks.size()];
+        xsmall_hmi::VisualObject* hit = nullptr;
+        for (auto it = scene.objects.rbegin(); it != scene.objects.rend(); ++it) {
+            if ((*it)->contains(point)) {
+                hit = it->get();
+                break;
+            }
+        }
+        benchmark::DoNotOptimize(hit);
+    }
+}
+BENCHMARK(BM_HitTestLinearScan)->Arg(1000)->Arg(10000)->Arg(100000);
+
+// View culling over heap objects, one pointer chase per object
+void BM_CullObjectList(benchmark::State& state) {
+    ClickScene scene(static_cast<std::size_t>(state.range(0)));
+    const sf::FloatRect view({1000, 800}, {1200, 800});
+    std::vector<xsmall_hmi::VisualObject*> visible;
+    
+    for (auto _ : state) {
+        visible.clear();
+        for (auto& obj : scene.objects) {
+            if (obj->getBounds().findIntersection(view)) {
+                visible.push_back(obj.get());
+            }
+        }
+        benchmark::DoNotOptimize(visible.data());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_CullObjectList)->Arg(10000)->Arg(100000);
+
+// Same cull over the packed bounds of a SceneStore
+void BM_CullSceneStore(benchmark::State& state) {
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> x(0.0f, 4000.0f);
+    std::uniform_real_distribution<float> y(0.0f, 3000.0f);
+    xsmall_hmi::SceneStore store;
+    for (std::int64_t i = 0; i < state.range(0); ++i) {
+        auto* rect = store.create<xsmall_hmi::RectangleObject>("rect_" + std::to_string(i));
+        rect->setPosition(sf::Vector2f(x(rng), y(rng)));
+        rect->setSize(sf::Vector2f(40, 25));
+    }
+    const sf::FloatRect view({1000, 800}, {1200, 800});
+    std::vector<xsmall_hmi::VisualObject*> visible;
+    
+    for (auto _ : state) {
+        visible.clear();
+        store.queryRect(view, visible);
+        benchmark::DoNotOptimize(visible.data());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_CullSceneStore)->Arg(10000)->Arg(100000);
+
+// Open + instantiate a saved screen of N mixed, partly bound objects
+void BM_SceneLoad(benchmark::State& state) {
+    const std::string path = "bench_scene.xhs";
+    {
+        VariableDatabase db;
+        xsmall_hmi::SceneStore objects;
+        for (std::int64_t i = 0; i < state.range(0); ++i) {
+            xsmall_hmi::VisualObject* obj;
+            if (i % 4 == 0) {
+                auto* polyline = objects.create<xsmall_hmi::PolylineObject>("poly_" + std::to_string(i));
+                for (int p = 0; p < 8; ++p) {
+                    polyline->addPoint(sf::Vector2f(p * 10.0f, (p % 2) * 10.0f));
+                }
+                obj = polyline;
+            } else if (i % 4 == 1) {
+                obj = objects.create<xsmall_hmi::TextObject>("text_" + std::to_string(i));
+                obj->setVariableBinding(db, "tag_" + std::to_string(i % 2000));
+            } else {
+                obj = objects.create<xsmall_hmi::RectangleObject>("rect_" + std::to_string(i));
+            }
+            obj->setPosition(sf::Vector2f(static_cast<float>(i % 400) * 10.0f, static_cast<float>(i / 400) * 10.0f));
+        }
+        xsmall_hmi::SceneFile::save(path, objects);
+    }
+    
+    for (auto _ : state) {
+        VariableDatabase db;
+        xsmall_hmi::SceneStore objects;
+        xsmall_hmi::SceneFile scene;
+        scene.open(path);
+        scene.load(db, objects);
+        benchmark::DoNotOptimize(objects.objects().data());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    std::remove(path.c_str());
+}
+BENCHMARK(BM_SceneLoad)->Arg(50000)->Unit(benchmark::kMillisecond);
+
+// Feeds the given tags as fast as its queue accepts updates
+class FloodSource : public xsmall_hmi::DataSource {
+public:
+    explicit FloodSource(std::size_t tags) : tags_(tags) {}
+    
+    std::string name() const override { return "flood"; }
+    bool prepare(VariableDatabase& db) override {
+        for (std::size_t i = 0; i < tags_; ++i) ids_.push_back(db.resolveId("feed_" + std::to_string(i)));
+        return true;
+    }
+    void run(xsmall_hmi::UpdateSink& sink, const std::atomic<bool>& stop) override {
+        float value = 0.0f;
+        for (std::size_t i = 0; !stop.load(std::memory_order_relaxed); ++i) {
+            if (!sink.push(ids_[i % ids_.size()], value += 1.0f)) std::this_thread::yield();
+        }
+    }
+    
+private:
+    std::size_t tags_;
+    std::vector<xsmall_hmi::VariableId> ids_;
+};
+
+// One frame's drain at N queued updates (100k/s at 60 fps is ~1700) across
+// 1000 subscribed tags, with a source thread writing concurrently
+void BM_IngestionDrain(benchmark::State& state) {
+    VariableDatabase db;
+    int fired = 0;
+    xsmall_hmi::Ingestion ingestion(1 << 14);
+    ingestion.addSource(std::make_unique<FloodSource>(1000));
+    ingestion.start(db);
+    std::vector<xsmall_hmi::Subscription> subscriptions;
+    for (std::size_t i = 0; i < 1000; ++i) {
+        subscriptions.push_back(db.subscribe("feed_" + std::to_string(i),
+            [&fired](const std::string&, const VariableDatabase::ValueType&) { ++fired; }));
+    }
+    
+    std::size_t applied = 0;
+    for (auto _ : state) {
+        applied += ingestion.drain(db, static_cast<std::size_t>(state.range(0)));
+    }
+    ingestion.stop();
+    benchmark::DoNotOptimize(fired);
+    state.SetItemsProcessed(static_cast<std::int64_t>(applied));
+}
+BENCHMARK(BM_IngestionDrain)->Arg(1700)->Arg(16384);
+
+} // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,154 @@
+#include "HeadlessRunner.hpp"
+#include "DataSources.hpp"
+#include "Ingestion.hpp"
+#include "TrafficLog.hpp"
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+namespace {
+
+void printUsage() {
+    std::cout << "Usage: xsmall_hmi_render_bench [options]\n"
+              << "  --objects N     objects on the screen (default 5000)\n"
+              << "  --variables N   tags the objects bind to (default 1000)\n"
+              << "  --changes N     tags written per frame (default 50)\n"
+              << "  --frames N      measured frames (default 600)\n"
+              << "  --threads N     update worker threads besides the render thread (default 0)\n"
+              << "  --feed N        background updates per second across all tags (default 0)\n"
+              << "  --record FILE   capture every variable write of the run to a traffic log\n"
+              << "  --replay FILE   drive the screen with a traffic log instead of synthetic writes\n"
+              << "  --speed S       replay speed; each frame advances S/60 s of recording (default 1)\n"
+              << "  --width W       target width (default 1200)\n"
+              << "  --height H      target height (default 800)\n"
+              << "  --save FILE     write the last frame as an image\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::size_t objects = 5000;
+    std::size_t variables = 1000;
+    std::size_t changes = 50;
+    std::size_t frames = 600;
+    bool framesGiven = false;
+    std::size_t threads = 0;
+    double feedRate = 0.0;
+    std::string recordFile;
+    std::string replayFile;
+    double speed = 1.0;
+    unsigned int width = 1200;
+    unsigned int height = 800;
+    std::string saveFile;
+    
+    for (int i = 1; i < argc; ++i) {
+        auto next = [&]() -> const char* { return i + 1 < argc ? argv[++i] : "0"; };
+        if (std::strcmp(argv[i], "--objects") == 0) objects = std::strtoul(next(), nullptr, 10);
+        else if (std::strcmp(argv[i], "--variables") == 0) variables = std::strtoul(next(), nullptr, 10);
+        else if (std::strcmp(argv[i], "--changes") == 0) changes = std::strtoul(next(), nullptr, 10);
+        else if (std::strcmp(argv[i], "--frames") == 0) {
+            frames = std::strtoul(next(), nullptr, 10);
+            framesGiven = true;
+        }
+        else if (std::strcmp(argv[i], "--threads") == 0) threads = std::strtoul(next(), nullptr, 10);
+        else if (std::strcmp(argv[i], "--feed") == 0) feedRate = std::strtod(next(), nullptr);
+        else if (std::strcmp(argv[i], "--record") == 0) recordFile = next();
+        else if (std::strcmp(argv[i], "--replay") == 0) replayFile = next();
+        else if (std::strcmp(argv[i], "--speed") == 0) speed = std::strtod(next(), nullptr);
+        else if (std::strcmp(argv[i], "--width") == 0) width = std::strtoul(next(), nullptr, 10);
+        else if (std::strcmp(argv[i], "--height") == 0) height = std::strtoul(next(), nullptr, 10);
+        else if (std::strcmp(argv[i], "--save") == 0) saveFile = next();
+        else {
+            printUsage();
+            return 1;
+        }
+    }
+    
+    xsmall_hmi::HeadlessRunner runner(sf::Vector2u(width, height));
+    if (!runner.isReady()) {
+        std::cerr << "Failed to create offscreen render target" << std::endl;
+        return 1;
+    }
+    runner.populate(objects, variables);
+    runner.setUpdateThreads(threads);
+    
+    // Optional background feed over the same tags, drained once per frame
+    xsmall_hmi::Ingestion ingestion;
+    if (feedRate > 0.0) {
+        std::vector<std::string> tags;
+        for (xsmall_hmi::VariableId id : runner.getVariables()) {
+            tags.push_back(runner.getDatabase().getName(id));
+        }
+        ingestion.addSource(std::make_unique<xsmall_hmi::SignalGenerator>(std::move(tags), feedRate));
+        ingestion.start(runner.getDatabase());
+    }
+    
+    // Replay runs on a fixed 60 Hz clock scaled by speed, so every run feeds
+    // the same writes into the same frames
+    xsmall_hmi::TrafficLog log;
+    xsmall_hmi::TrafficReplayer replayer(log);
+    const double frameStep = speed / 60.0;
+    if (!replayFile.empty()) {
+        if (!log.open(replayFile) || frameStep <= 0.0) {
+            std::cerr << "Failed to open traffic log " << replayFile << std::endl;
+            return 1;
+        }
+        replayer.prepare(runner.getDatabase());
+        if (!framesGiven) {
+            frames = static_cast<std::size_t>(std::ceil(log.duration() / frameStep)) + 1;
+        }
+    }
+    
+    // Warm-up frame builds the batches and text layouts
+    runner.run(1);
+    
+    xsmall_hmi::TrafficRecorder recorder(runner.getDatabase());
+    if (!recordFile.empty() && !recorder.start(recordFile)) {
+        std::cerr << "Failed to create traffic log " << recordFile << std::endl;
+        return 1;
+    }
+    
+    std::size_t cursor = 0;
+    std::size_t replayed = 0;
+    auto stats = runner.run(frames, [&](std::size_t frame, xsmall_hmi::VariableDatabase& db) {
+        ingestion.drain(db);
+        if (!replayFile.empty()) {
+            replayed += replayer.advance(db, frameStep);
+            return;
+        }
+        const auto& tags = runner.getVariables();
+        for (std::size_t i = 0; i < changes && !tags.empty(); ++i) {
+            db.setVariable(tags[cursor++ % tags.size()], static_cast<float>(frame % 100));
+        }
+    });
+    recorder.stop();
+    
+    std::cout << "Objects: " << objects << ", tags: " << variables
+              << ", changes/frame: " << changes << ", update threads: " << threads << std::endl;
+    std::cout << "Frames: " << stats.frames << std::endl;
+    std::cout << "Frame time (ms): mean " << stats.mean
+              << ", p50 " << stats.p50
+              << ", p90 " << stats.p90
+              << ", p99 " << stats.p99
+              << ", max " << stats.max << std::endl;
+    if (!replayFile.empty()) {
+        std::cout << "Replayed " << replayed << " of " << log.events().size() << " writes ("
+                  << replayer.position() << " of " << log.duration() << " s at " << speed << "x)" << std::endl;
+    }
+    if (!recordFile.empty()) {
+        std::cout << "Recorded " << recorder.eventCount() << " writes to " << recordFile << std::endl;
+    }
+    if (feedRate > 0.0) {
+        ingestion.stop();
+        std::cout << "Feed: " << ingestion.appliedUpdates() << " updates applied, "
+                  << ingestion.droppedUpdates() << " dropped" << std::endl;
+    }
+    
+    if (!saveFile.empty() && !runner.saveFrame(saveFile)) {
+        std::cerr << "Failed to save " << saveFile << std::endl;
+        return 1;
+    }
+    return 0;
+}